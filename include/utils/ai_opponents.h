@@ -0,0 +1,221 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include "./physics.h"
+#include "./vehicle.h"
+#include "./driver.h"
+#include "./racing_line.h"
+#include "./tyre_model.h"
+
+// state of the opponents not kept in the rigid bodies of the chassis, saved by a WorldSnapshot
+struct AiOpponentsState {
+    std::vector<VehicleState> vehicles;
+    // progress and laps on the line
+    std::vector<RacingLineDriver> drivers;
+};
+
+// AI cars racing on a RacingLine: each one is a Vehicle (the same of the player) driven by a RacingLineDriver.
+// The drivers of a frame run in parallel on a pool of worker threads, created once: a driver only queries the
+// line and gives the commands to its vehicle. The vehicles are then updated on the calling thread, since
+// Vehicle::Update can change the world (the projectiles).
+// The vehicles start on a grid behind the start of the line, two by row. When a TyreModel is given they are
+// added to it, so the tyres of all the vehicles are evaluated in the same batch.
+class AiOpponents {
+public:
+    AiOpponents(Physics &simulation, const RacingLine &line, const glm::vec3 &chassisSize, const WheelInfo &wheelInfo,
+                TyreModel *tyreModel = nullptr, int threadCount = 0):
+        simulation(simulation), line(line), chassisSize(chassisSize), wheelInfo(wheelInfo), tyreModel(tyreModel) {
+        if(threadCount <= 0) threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+        for(int i = 0; i < threadCount; i++) {
+            workers.emplace_back([this]() { work(); });
+        }
+    }
+
+    ~AiOpponents() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        startDriving.notify_all();
+        for(auto &worker: workers) worker.join();
+        SetCount(0);
+    }
+
+    AiOpponents(const AiOpponents& copy) = delete; //disallow copy
+    AiOpponents& operator=(const AiOpponents &) = delete;
+
+    // adds or removes vehicles, the new ones start behind the last row of the grid
+    void SetCount(int count) {
+        while(vehicles.size() > count) {
+            removeVehicle();
+        }
+        while(vehicles.size() < count) {
+            addVehicle();
+        }
+    }
+
+    int Count() {
+        return vehicles.size();
+    }
+
+    Vehicle &GetVehicle(int i) {
+        return *vehicles[i];
+    }
+
+    RacingLineDriver &GetDriver(int i) {
+        return drivers[i];
+    }
+
+    int ThreadCount() {
+        return workers.size() + 1;
+    }
+
+    void SaveState(AiOpponentsState &state) {
+        state.vehicles.resize(vehicles.size());
+        for(int i = 0; i < vehicles.size(); i++) {
+            vehicles[i]->SaveState(state.vehicles[i]);
+        }
+        state.drivers = drivers;
+    }
+
+    // the chassis are restored with all the other rigid bodies, here only the wheels and the drivers
+    void RestoreState(const AiOpponentsState &state) {
+        // a state saved with other opponents can't be restored
+        if(state.vehicles.size() != vehicles.size()) return;
+        for(int i = 0; i < vehicles.size(); i++) {
+            vehicles[i]->RestoreState(state.vehicles[i]);
+        }
+        drivers = state.drivers;
+    }
+
+    // drives and updates all the vehicles
+    void Update(float deltaTime) {
+        btClock clock;
+        frameDeltaTime = deltaTime;
+        nextVehicle = 0;
+        // few vehicles are driven faster than waking the workers
+        if(vehicles.size() >= ParallelThreshold && !workers.empty()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pendingWorkers = workers.size();
+                generation++;
+            }
+            startDriving.notify_all();
+            drive();
+            std::unique_lock<std::mutex> lock(mutex);
+            finishedDriving.wait(lock, [this]() { return pendingWorkers == 0; });
+        } else {
+            drive();
+        }
+        DriveTime = clock.getTimeMicroseconds() / 1000.f;
+
+        for(auto &vehicle: vehicles) {
+            vehicle->Update(deltaTime);
+        }
+    }
+
+    // vehicles driven on the workers only from this number
+    int ParallelThreshold = 8;
+    // time of the drivers of the last update (ms)
+    float DriveTime = 0.f;
+    // distance between the rows of the grid and between the two vehicles of a row
+    float GridSpacing = 10.f;
+    float GridWidth = 4.f;
+
+private:
+    Physics &simulation;
+    const RacingLine &line;
+    glm::vec3 chassisSize;
+    WheelInfo wheelInfo;
+    TyreModel *tyreModel;
+    std::vector<std::unique_ptr<Vehicle>> vehicles;
+    std::vector<RacingLineDriver> drivers;
+
+    // worker threads, waiting for the next generation of drivers to run
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable startDriving, finishedDriving;
+    int generation = 0;
+    int pendingWorkers = 0;
+    bool stopping = false;
+    std::atomic<int> nextVehicle {0};
+    float frameDeltaTime = 0.f;
+
+    // each thread takes the next vehicle not driven yet
+    void drive() {
+        int count = vehicles.size();
+        for(int i = nextVehicle++; i < count; i = nextVehicle++) {
+            drivers[i].Drive(*vehicles[i], line, frameDeltaTime);
+        }
+    }
+
+    void work() {
+        int lastGeneration = 0;
+        while(true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                startDriving.wait(lock, [&]() { return stopping || generation != lastGeneration; });
+                if(stopping) return;
+                lastGeneration = generation;
+            }
+            drive();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(--pendingWorkers == 0) finishedDriving.notify_one();
+            }
+        }
+    }
+
+    void addVehicle() {
+        int i = vehicles.size();
+        // the opponents don't shoot, no projectile pool
+        vehicles.emplace_back(new Vehicle(simulation, chassisSize, wheelInfo, 0));
+        Vehicle &vehicle = *vehicles.back();
+        drivers.emplace_back();
+        // the rows are packed closer on a short line, the grid can't be longer than a lap
+        int rows = i / 2 + 1;
+        float spacing = std::min(GridSpacing, line.Length() / (rows + 1));
+        float distance = -spacing * rows;
+        float offset = (i % 2 == 0 ? -.5f : .5f) * GridWidth;
+        drivers.back().Offset = offset;
+        drivers.back().Progress = line.Length() + distance;
+
+        glm::vec3 direction = line.DirectionAt(distance);
+        glm::vec3 position = line.PointAt(distance) + glm::normalize(glm::vec3(-direction.z, 0.f, direction.x)) * offset;
+        // +z of the chassis along the line, a bit above it
+        btTransform transform(btQuaternion(btVector3(0, 1, 0), atan2(direction.x, direction.z)), btVector3(position.x, position.y + 1.f, position.z));
+        vehicle.Chassis->setWorldTransform(transform);
+        vehicle.Chassis->getMotionState()->setWorldTransform(transform);
+        vehicle.Chassis->setInterpolationWorldTransform(transform);
+        vehicle.GetBulletVehicle().resetSuspension();
+        if(tyreModel) tyreModel->Add(vehicle);
+    }
+
+    void removeVehicle() {
+        Vehicle &vehicle = *vehicles.back();
+        if(tyreModel) tyreModel->Remove(vehicle);
+        // chassis and shape are deleted here only if the world is still there,
+        // otherwise they have been deleted with the world (see Physics::Clear)
+        btRigidBody *chassis = vehicle.Chassis;
+        bool inWorld = simulation.dynamicsWorld != nullptr;
+        vehicles.pop_back();
+        drivers.pop_back();
+        if(inWorld) {
+            simulation.dynamicsWorld->removeRigidBody(chassis);
+            btCollisionShape *shape = chassis->getCollisionShape();
+            simulation.collisionShapes.remove(shape);
+            delete shape;
+            delete chassis->getMotionState();
+            delete chassis;
+        }
+    }
+};
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include "./physics.h"
+
+enum ContactEventType {
+    // the two objects started touching in this step
+    CONTACT_BEGIN,
+    // the two objects are still touching (at least one of them is awake)
+    CONTACT_PERSIST,
+    // the two objects are not touching anymore (or one of them was removed from the world)
+    CONTACT_END,
+};
+
+struct ContactEvent {
+    ContactEventType Type;
+    // the two objects, always ordered by address so a pair has always the same A and B
+    // N.B.) with the end events the objects can be already removed from the world, or deleted
+    const btCollisionObject *ObjectA;
+    const btCollisionObject *ObjectB;
+    // deepest contact point (on B) and normal from B to A, for the end events the last ones seen
+    btVector3 Point;
+    btVector3 Normal;
+    // impulse applied by the solver to separate the objects in the step (sum of all the contact points)
+    btScalar Impulse;
+    // internal step of the world when the event happened
+    int Step;
+};
+
+// Queue of the contacts between the objects of a world, to react to the collisions (e.g. projectile hits,
+// pins knocked over) without checking the bodies every frame.
+// After each internal step (so also for the substeps) the persistent manifolds of the dispatcher are walked
+// once and compared with the contacts of the previous step: begin, persist and end events are written in a
+// ring buffer, read in bulk by the game with Read.
+// All the memory is allocated at the creation: when the buffer is full the new events are dropped (and
+// counted), the arrays of the touching pairs grow only if the contacts are more than the reserved ones.
+class ContactEventQueue {
+public:
+    ContactEventQueue(Physics &simulation, int capacity = 4096, int reservedPairs = 1024): simulation(simulation) {
+        events.resize(capacity);
+        touchingPairs[0].reserve(reservedPairs);
+        touchingPairs[1].reserve(reservedPairs);
+        tickCallback = simulation.AddTickCallback([this](btScalar) { collect(); });
+    }
+
+    ~ContactEventQueue() {
+        simulation.RemoveTickCallback(tickCallback);
+    }
+
+    ContactEventQueue(const ContactEventQueue& copy) = delete; //disallow copy
+    ContactEventQueue& operator=(const ContactEventQueue &) = delete;
+
+    // copies up to maxEvents events (the oldest first) and removes them from the queue, returns the number of events
+    int Read(ContactEvent *out, int maxEvents) {
+        int count = std::min(maxEvents, size);
+        for(int i = 0; i < count; i++) {
+            out[i] = events[(head + i) % events.size()];
+        }
+        head = (head + count) % events.size();
+        size -= count;
+        return count;
+    }
+
+    int Count() {
+        return size;
+    }
+
+    void Clear() {
+        head = 0;
+        size = 0;
+    }
+
+    // only pairs with at least an object of these collision categories generate events
+    int Groups = btBroadphaseProxy::AllFilter;
+    // persist events can be disabled when only the begin and end of the contacts are needed
+    bool PersistEvents = true;
+    // events lost because the buffer was full
+    int Dropped = 0;
+
+private:
+    struct TouchingPair {
+        const btCollisionObject *objectA;
+        const btCollisionObject *objectB;
+        btVector3 point;
+        btVector3 normal;
+        btScalar impulse;
+        bool awake;
+
+        bool operator<(const TouchingPair &other) const {
+            return objectA < other.objectA || (objectA == other.objectA && objectB < other.objectB);
+        }
+
+        // comparator for btAlignedObjectArray::quickSort
+        bool operator()(const TouchingPair &a, const TouchingPair &b) const {
+            return a < b;
+        }
+
+        bool samePair(const TouchingPair &other) const {
+            return objectA == other.objectA && objectB == other.objectB;
+        }
+    };
+
+    Physics &simulation;
+    int tickCallback;
+    // aligned arrays, the structs contain btVector3
+    btAlignedObjectArray<ContactEvent> events;
+    int head = 0;
+    int size = 0;
+    int step = 0;
+    // touching pairs of the current and of the previous step (sorted), they switch at each step
+    btAlignedObjectArray<TouchingPair> touchingPairs[2];
+    int currentPairs = 0;
+
+    void push(ContactEventType type, const TouchingPair &pair) {
+        if(size == events.size()) {
+            Dropped++;
+            return;
+        }
+        events[(head + size) % events.size()] = ContactEvent{type, pair.objectA, pair.objectB, pair.point, pair.normal, pair.impulse, step};
+        size++;
+    }
+
+    bool wanted(const btCollisionObject *object) {
+        auto proxy = object->getBroadphaseHandle();
+        return proxy && (proxy->m_collisionFilterGroup & Groups);
+    }
+
+    void collect() {
+        auto dispatcher = simulation.dynamicsWorld->getDispatcher();
+        auto &pairs = touchingPairs[currentPairs];
+        auto &previousPairs = touchingPairs[1 - currentPairs];
+        // resize keeps the memory, clear would release it
+        pairs.resize(0);
+        int manifolds = dispatcher->getNumManifolds();
+        for(int i = 0; i < manifolds; i++) {
+            btPersistentManifold *manifold = dispatcher->getManifoldByIndexInternal(i);
+            auto object0 = manifold->getBody0(), object1 = manifold->getBody1();
+            if(!wanted(object0) && !wanted(object1)) continue;
+
+            // the deepest point of the manifold, the points kept by Bullet a bit farther than the contact are ignored
+            int deepest = -1;
+            btScalar impulse = 0;
+            for(int p = 0; p < manifold->getNumContacts(); p++) {
+                const btManifoldPoint &point = manifold->getContactPoint(p);
+                if(point.getDistance() > 0) continue;
+                impulse += point.getAppliedImpulse();
+                if(deepest < 0 || point.getDistance() < manifold->getContactPoint(deepest).getDistance()) deepest = p;
+            }
+            if(deepest < 0) continue;
+
+            const btManifoldPoint &point = manifold->getContactPoint(deepest);
+            TouchingPair pair;
+            pair.objectA = object0;
+            pair.objectB = object1;
+            pair.point = point.getPositionWorldOnB();
+            pair.normal = point.m_normalWorldOnB;
+            if(object1 < object0) {
+                std::swap(pair.objectA, pair.objectB);
+                pair.point = point.getPositionWorldOnA();
+                pair.normal = -pair.normal;
+            }
+            pair.impulse = impulse;
+            pair.awake = object0->isActive() || object1->isActive();
+            pairs.push_back(pair);
+        }
+
+        // the same pair can have more manifolds (e.g. compound shapes): they are merged summing the impulses
+        pairs.quickSort(TouchingPair());
+        int merged = 0;
+        for(int i = 0; i < pairs.size(); i++) {
+            if(merged > 0 && pairs[merged - 1].samePair(pairs[i])) {
+                pairs[merged - 1].impulse += pairs[i].impulse;
+                pairs[merged - 1].awake = pairs[merged - 1].awake || pairs[i].awake;
+            } else {
+                pairs[merged++] = pairs[i];
+            }
+        }
+        pairs.resize(merged);
+
+        // both the arrays are sorted: the pairs only in the current one begin, the ones only in the previous end
+        int current = 0, previous = 0;
+        while(current < pairs.size() || previous < previousPairs.size()) {
+            if(previous == previousPairs.size() || (current < pairs.size() && pairs[current] < previousPairs[previous])) {
+                push(CONTACT_BEGIN, pairs[current++]);
+            } else if(current == pairs.size() || previousPairs[previous] < pairs[current]) {
+                TouchingPair ended = previousPairs[previous++];
+                ended.impulse = 0;
+                push(CONTACT_END, ended);
+            } else {
+                // the contacts between sleeping objects don't change
+                if(PersistEvents && pairs[current].awake) push(CONTACT_PERSIST, pairs[current]);
+                current++;
+                previous++;
+            }
+        }
+        currentPairs = 1 - currentPairs;
+        step++;
+    }
+};
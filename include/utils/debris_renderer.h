@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "./renderer.h"
+#include "./destructible.h"
+#include "./render_motion_state.h"
+
+// Renderer of the debris of the destructible props with instancing: the model matrices of all the debris are
+// written in one buffer, grouped by fragment of the pattern, and each fragment mesh is drawn once with all its
+// instances. The draw calls are as many as the fragments of the pattern, not as the debris in the world.
+class DebrisRenderer : public Renderer {
+public:
+    DebrisRenderer(DestructibleProps &props): props(props) {
+        shader = new Shader("debris.vert", "debris.frag");
+        int fragments = props.Pattern.Fragments.size();
+        counts.resize(fragments);
+        starts.resize(fragments);
+        modelMatrices.resize(props.Size());
+
+        glGenBuffers(1, &modelMatrixBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, modelMatrixBuffer);
+        glBufferData(GL_ARRAY_BUFFER, modelMatrices.size() * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void SetColor(glm::vec3 color) {
+        glUniform3fv(glGetUniformLocation(shader->Program, "color"), 1, glm::value_ptr(color));
+    }
+
+    void SetLightDirection(glm::vec3 lightDirection) {
+        glUniform3fv(glGetUniformLocation(shader->Program, "lightVector"), 1, glm::value_ptr(lightDirection));
+    }
+
+    // draws all the debris in the world, the renderer should be active
+    void Draw() {
+        if(props.ActiveCount() == 0) return;
+        auto &fragments = props.Pattern.Fragments;
+
+        // the matrices of the same fragment are contiguous in the buffer
+        std::fill(counts.begin(), counts.end(), 0);
+        props.ForEachDebris([&](int fragment, btRigidBody *) { counts[fragment]++; });
+        int total = 0;
+        for(int f = 0; f < fragments.size(); f++) {
+            starts[f] = total;
+            total += counts[f];
+        }
+        props.ForEachDebris([&](int fragment, btRigidBody *body) {
+            // the matrix is rebuilt only if the debris moved (see RenderMotionState)
+            auto motionState = (RenderMotionState*) body->getMotionState();
+            modelMatrices[starts[fragment]++] = motionState->ModelMatrix(glm::vec3(1.f));
+        });
+
+        glBindBuffer(GL_ARRAY_BUFFER, modelMatrixBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, total * sizeof(glm::mat4), &modelMatrices[0]);
+        auto vec4Size = sizeof(glm::vec4);
+        for(int f = 0; f < fragments.size(); f++) {
+            if(counts[f] == 0) continue;
+            // starts[f] is now the end of the fragment matrices
+            size_t first = (starts[f] - counts[f]) * sizeof(glm::mat4);
+            glBindVertexArray(fragments[f].Geometry.VAO);
+            // the instanced model matrix, 4 attributes (one for each column) after the ones of the mesh
+            for(int column = 0; column < 4; column++) {
+                glEnableVertexAttribArray(5 + column);
+                glVertexAttribPointer(5 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(first + column * vec4Size));
+                glVertexAttribDivisor(5 + column, 1);
+            }
+            glDrawElementsInstanced(GL_TRIANGLES, fragments[f].Geometry.indices.size(), GL_UNSIGNED_INT, 0, counts[f]);
+        }
+        glBindVertexArray(0);
+    }
+
+    void Delete() {
+        Renderer::Delete();
+        glDeleteBuffers(1, &modelMatrixBuffer);
+    }
+
+private:
+    DestructibleProps &props;
+    GLuint modelMatrixBuffer;
+    // instances of each fragment and their first matrix in the buffer
+    std::vector<int> counts;
+    std::vector<int> starts;
+    std::vector<glm::mat4> modelMatrices;
+};
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <vector>
+#include <iostream>
+
+#include <glad/glad.h>
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include "./renderer.h"
+
+// Renderer of the debug lines of Bullet (shapes, AABBs, contact points, the rays of the wheels).
+// The lines given by dynamicsWorld->debugDrawWorld() are collected in an array and drawn with a single
+// glDrawArrays(GL_LINES) per frame, from one vertex buffer:
+// - at the start of the buffer the lines of the static objects (the track, the obstacles), generated once and
+//   uploaded only when a new static object is found. These objects are flagged with CF_DISABLE_VISUALIZE_OBJECT,
+//   so Bullet skips them when drawing the world: the meshes with hundreds of thousands of triangles are not
+//   walked at every frame
+// - after them the lines of the moving objects, the contacts and the actions, uploaded at every frame
+// The snow heightfield changes with the snow, so it's drawn at every frame like the moving objects.
+class PhysicsDebugRenderer : public Renderer, public btIDebugDraw {
+public:
+    PhysicsDebugRenderer(int reservedLines = 65536) {
+        shader = new Shader("debug_lines.vert", "debug_lines.frag");
+        lines.reserve(reservedLines * 2);
+
+        glGenVertexArrays(1, &linesVAO);
+        glGenBuffers(1, &linesVBO);
+        glBindVertexArray(linesVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, linesVBO);
+        bufferSize = reservedLines * 2 * sizeof(LineVertex);
+        glBufferData(GL_ARRAY_BUFFER, bufferSize, NULL, GL_DYNAMIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (void*)(3 * sizeof(float)));
+        glBindVertexArray(0);
+    }
+
+    // collects the lines of the world and draws them, the renderer should be active
+    void Draw(btCollisionWorld *world) {
+        if(world->getDebugDrawer() != this) world->setDebugDrawer(this);
+        cacheStaticObjects(world);
+        // the lines of the previous frame are removed by clearLines, called by Bullet
+        target = &lines;
+        world->debugDrawWorld();
+
+        size_t staticBytes = staticLines.size() * sizeof(LineVertex), bytes = lines.size() * sizeof(LineVertex);
+        glBindBuffer(GL_ARRAY_BUFFER, linesVBO);
+        if(staticBytes + bytes > bufferSize) {
+            // the buffer grows (doubling) and the static lines are uploaded again
+            while(staticBytes + bytes > bufferSize) bufferSize *= 2;
+            glBufferData(GL_ARRAY_BUFFER, bufferSize, NULL, GL_DYNAMIC_DRAW);
+            staticUploaded = false;
+        }
+        if(!staticUploaded && staticBytes > 0) {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, staticBytes, &staticLines[0]);
+        }
+        staticUploaded = true;
+        if(bytes > 0) {
+            glBufferSubData(GL_ARRAY_BUFFER, staticBytes, bytes, &lines[0]);
+        }
+
+        glBindVertexArray(linesVAO);
+        glDrawArrays(GL_LINES, 0, (GLsizei) (staticLines.size() + lines.size()));
+        glBindVertexArray(0);
+    }
+
+    // the static lines are generated again at the next draw (e.g. after a static object was removed or moved)
+    void Invalidate() {
+        for(auto object: cachedObjects) {
+            object->setCollisionFlags(object->getCollisionFlags() & ~btCollisionObject::CF_DISABLE_VISUALIZE_OBJECT);
+        }
+        cachedObjects.clear();
+        staticLines.clear();
+        staticUploaded = false;
+    }
+
+    // number of lines drawn in the last frame
+    int StaticLines() {
+        return staticLines.size() / 2;
+    }
+
+    int DynamicLines() {
+        return lines.size() / 2;
+    }
+
+    /// btIDebugDraw
+    void drawLine(const btVector3 &from, const btVector3 &to, const btVector3 &color) override {
+        target->push_back(LineVertex{from.x(), from.y(), from.z(), color.x(), color.y(), color.z()});
+        target->push_back(LineVertex{to.x(), to.y(), to.z(), color.x(), color.y(), color.z()});
+    }
+
+    void drawContactPoint(const btVector3 &pointOnB, const btVector3 &normalOnB, btScalar distance, int, const btVector3 &color) override {
+        // the normal of the contact, with a minimum length to see also the resting contacts
+        drawLine(pointOnB, pointOnB + normalOnB * btMax(distance, btScalar(.2f)), color);
+    }
+
+    void reportErrorWarning(const char *warningString) override {
+        std::cout << "Bullet: " << warningString << std::endl;
+    }
+
+    void draw3dText(const btVector3 &, const char *) override { }
+
+    void setDebugMode(int mode) override {
+        // the static lines depend on the mode (e.g. with or without the AABBs)
+        if(mode != debugMode) Invalidate();
+        debugMode = mode;
+    }
+
+    int getDebugMode() const override {
+        return debugMode;
+    }
+
+    void clearLines() override {
+        // clear keeps the memory of the vector
+        lines.clear();
+    }
+
+    void Delete() {
+        Invalidate();
+        Renderer::Delete();
+        glDeleteBuffers(1, &linesVBO);
+        glDeleteVertexArrays(1, &linesVAO);
+    }
+
+private:
+    struct LineVertex {
+        float x, y, z;
+        float r, g, b;
+    };
+
+    int debugMode = DBG_DrawWireframe | DBG_DrawContactPoints;
+    // lines of the moving objects (current frame) and of the static ones
+    std::vector<LineVertex> lines;
+    std::vector<LineVertex> staticLines;
+    // array written by drawLine
+    std::vector<LineVertex> *target = &lines;
+    std::vector<btCollisionObject*> cachedObjects;
+    bool staticUploaded = false;
+
+    GLuint linesVAO, linesVBO;
+    size_t bufferSize;
+
+    bool cacheable(const btCollisionObject *object) {
+        return object->isStaticObject() && object->getCollisionShape()->getShapeType() != TERRAIN_SHAPE_PROXYTYPE;
+    }
+
+    void cacheStaticObjects(btCollisionWorld *world) {
+        auto &objects = world->getCollisionObjectArray();
+        bool changed = false;
+        for(int i = 0; i < objects.size() && !changed; i++) {
+            changed = cacheable(objects[i]) && !(objects[i]->getCollisionFlags() & btCollisionObject::CF_DISABLE_VISUALIZE_OBJECT);
+        }
+        if(!changed) return;
+
+        // all the static lines are generated again, the static objects are a few
+        Invalidate();
+        target = &staticLines;
+        auto colors = getDefaultColors();
+        for(int i = 0; i < objects.size(); i++) {
+            auto object = objects[i];
+            if(!cacheable(object) || (object->getCollisionFlags() & btCollisionObject::CF_DISABLE_VISUALIZE_OBJECT)) continue;
+            // static objects never move, they are drawn like the sleeping ones
+            if(debugMode & DBG_DrawWireframe)
+                world->debugDrawObject(object->getWorldTransform(), object->getCollisionShape(), colors.m_deactivatedObject);
+            if(debugMode & DBG_DrawAabb) {
+                btVector3 aabbMin, aabbMax;
+                object->getCollisionShape()->getAabb(object->getWorldTransform(), aabbMin, aabbMax);
+                drawAabb(aabbMin, aabbMax, colors.m_aabb);
+            }
+            object->setCollisionFlags(object->getCollisionFlags() | btCollisionObject::CF_DISABLE_VISUALIZE_OBJECT);
+            cachedObjects.push_back(object);
+        }
+        target = &lines;
+    }
+};
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include "./physics.h"
+#include "./fracture.h"
+#include "./contact_events.h"
+
+// state of the breaks and of the debris pool, saved by a WorldSnapshot: the transforms and velocities
+// of the bodies are saved with all the other bodies of the world
+struct DestructibleState {
+    struct Piece {
+        int fragment;
+        btScalar mass;
+        float age;
+        bool active;
+    };
+    std::vector<bool> broken;
+    std::vector<bool> pending;
+    std::vector<int> pendingBreaks;
+    std::vector<Piece> debris;
+    int brokenCount;
+};
+
+// Boxes that break in the fragments of a baked FracturedBox when hit hard enough.
+// The fragments are rigid bodies of a fixed-size pool, allocated once like the projectiles: a break removes the
+// box from the world and adds a fragment body for each piece of the pattern, changing only its shape and mass.
+// When the pool is empty the oldest debris is recycled, and the debris older than Lifetime is removed.
+// The breaks found by the contacts of a frame are queued and at most BreaksPerUpdate are done at each update,
+// so when many boxes break at once the work is spread over the next frames instead of a single long frame.
+// The debris has the COLLISION_DEBRIS category: it touches only the static world.
+class DestructibleProps {
+public:
+    DestructibleProps(Physics &simulation, FracturedBox &pattern, int poolSize = 256, float friction = .5f, float restitution = .1f):
+        Pattern(pattern), simulation(simulation) {
+        debris.resize(poolSize);
+        for(auto &piece: debris) {
+            // shape and mass are set when the piece is spawned
+            RenderMotionState* motionState = new RenderMotionState(btTransform::getIdentity());
+            btRigidBody::btRigidBodyConstructionInfo rbInfo(1.f, motionState, pattern.Fragments[0].Shape);
+            rbInfo.m_friction = friction;
+            rbInfo.m_restitution = restitution;
+            rbInfo.m_linearSleepingThreshold = simulation.Config.LinearSleepingThreshold;
+            rbInfo.m_angularSleepingThreshold = simulation.Config.AngularSleepingThreshold;
+            piece.body = new btRigidBody(rbInfo);
+        }
+        pendingBreaks.reserve(poolSize);
+    }
+
+    DestructibleProps(const DestructibleProps& copy) = delete; //disallow copy
+    DestructibleProps& operator=(const DestructibleProps &) = delete;
+
+    ~DestructibleProps() {
+        // bodies in the world are deallocated by the world (see Physics::Clear),
+        // only the ones kept out of the world are deleted here
+        for(auto &piece: debris) {
+            if(piece.active) continue;
+            delete piece.body->getMotionState();
+            delete piece.body;
+        }
+        for(auto &prop: props) {
+            if(!prop.broken) continue;
+            delete prop.body->getMotionState();
+            delete prop.body;
+        }
+    }
+
+    // the box (with the size of the pattern) can break, the user index of the body is used to find it
+    void Add(btRigidBody *body) {
+        body->setUserIndex(props.size());
+        // the categories are kept to add the box again to the world when a snapshot is restored
+        auto proxy = body->getBroadphaseHandle();
+        int group = proxy ? proxy->m_collisionFilterGroup : COLLISION_PROP;
+        int mask = proxy ? proxy->m_collisionFilterMask : collisionMask(COLLISION_PROP);
+        props.push_back(Prop{body, false, false, group, mask});
+    }
+
+    // queues the break of the props hit harder than BreakImpulse
+    void OnContact(const ContactEvent &event) {
+        if(event.Type == CONTACT_END || event.Impulse < BreakImpulse) return;
+        hit(event.ObjectA);
+        hit(event.ObjectB);
+    }
+
+    // breaks the queued props and removes the old debris
+    void Update(float deltaTime) {
+        for(auto &piece: debris) {
+            if(!piece.active) continue;
+            piece.age += deltaTime;
+            if(piece.age > Lifetime) despawn(piece);
+        }
+
+        int breaks = std::min(BreaksPerUpdate, (int) pendingBreaks.size());
+        for(int i = 0; i < breaks; i++) {
+            breakProp(props[pendingBreaks[i]]);
+        }
+        pendingBreaks.erase(pendingBreaks.begin(), pendingBreaks.begin() + breaks);
+    }
+
+    // calls draw(fragment index, body) for each debris in the world
+    template <typename DrawFunction>
+    void ForEachDebris(DrawFunction draw) {
+        for(auto &piece: debris) {
+            if(piece.active) draw(piece.fragment, piece.body);
+        }
+    }
+
+    int ActiveCount() {
+        return activeCount;
+    }
+
+    int Size() {
+        return debris.size();
+    }
+
+    int BrokenCount() {
+        return brokenCount;
+    }
+
+    void SaveState(DestructibleState &state) {
+        state.broken.resize(props.size());
+        state.pending.resize(props.size());
+        for(int i = 0; i < props.size(); i++) {
+            state.broken[i] = props[i].broken;
+            state.pending[i] = props[i].pending;
+        }
+        state.pendingBreaks = pendingBreaks;
+        state.debris.resize(debris.size());
+        for(int i = 0; i < debris.size(); i++) {
+            auto &piece = debris[i];
+            btScalar invMass = piece.body->getInvMass();
+            state.debris[i] = DestructibleState::Piece{piece.fragment, invMass > 0 ? 1.f / invMass : 0.f, piece.age, piece.active};
+        }
+        state.brokenCount = brokenCount;
+    }
+
+    // adds and removes the boxes and the debris to have in the world the same ones of the saved state,
+    // their transform and velocity are restored with all the other bodies by the snapshot
+    void RestoreState(const DestructibleState &state) {
+        // a state saved before some boxes were added can't be restored
+        if(state.broken.size() != props.size() || state.debris.size() != debris.size()) return;
+        for(int i = 0; i < props.size(); i++) {
+            auto &prop = props[i];
+            if(prop.broken && !state.broken[i]) {
+                simulation.AddRigidBody(prop.body, prop.group, prop.mask);
+            } else if(!prop.broken && state.broken[i]) {
+                simulation.dynamicsWorld->removeRigidBody(prop.body);
+            }
+            prop.broken = state.broken[i];
+            prop.pending = state.pending[i];
+        }
+        pendingBreaks = state.pendingBreaks;
+        brokenCount = state.brokenCount;
+
+        for(int i = 0; i < debris.size(); i++) {
+            auto &piece = debris[i];
+            auto &saved = state.debris[i];
+            // a piece recycled after the capture can be a different fragment (or of a box with a different mass),
+            // it's spawned again with the saved one
+            bool recycled = piece.fragment != saved.fragment || btFabs(piece.body->getInvMass() * saved.mass - 1.f) > 1e-4f;
+            if(piece.active && (!saved.active || recycled)) despawn(piece);
+            if(!piece.active && saved.active) {
+                setFragment(piece, saved.fragment, saved.mass, piece.body->getWorldTransform());
+                simulation.AddRigidBody(piece.body, COLLISION_DEBRIS);
+                piece.active = true;
+                activeCount++;
+            }
+            piece.age = saved.age;
+        }
+    }
+
+    FracturedBox &Pattern;
+    // impulse of a contact (N*s, sum of the contact points of the step) breaking a prop
+    float BreakImpulse = 20.f;
+    // speed of the fragments away from the center of the prop
+    float BurstSpeed = 2.f;
+    // seconds before the debris is removed from the world
+    float Lifetime = 15.f;
+    // props broken at most at each update
+    int BreaksPerUpdate = 4;
+
+private:
+    struct Prop {
+        btRigidBody *body;
+        bool broken;
+        bool pending;
+        // categories of the box in the world
+        int group;
+        int mask;
+    };
+
+    struct Debris {
+        btRigidBody *body = nullptr;
+        // fragment of the pattern used by the body
+        int fragment = 0;
+        float age = 0.f;
+        bool active = false;
+    };
+
+    Physics &simulation;
+    std::vector<Prop> props;
+    std::vector<Debris> debris;
+    std::vector<int> pendingBreaks;
+    int activeCount = 0;
+    int brokenCount = 0;
+
+    void hit(const btCollisionObject *object) {
+        int index = object->getUserIndex();
+        if(index < 0 || index >= props.size() || props[index].body != object) return;
+        auto &prop = props[index];
+        if(prop.broken || prop.pending) return;
+        prop.pending = true;
+        pendingBreaks.push_back(index);
+    }
+
+    Debris &takeDebris() {
+        Debris *taken = nullptr;
+        for(auto &piece: debris) {
+            if(!piece.active) return piece;
+            if(!taken || piece.age > taken->age) taken = &piece;
+        }
+        despawn(*taken);
+        return *taken;
+    }
+
+    void despawn(Debris &piece) {
+        simulation.dynamicsWorld->removeRigidBody(piece.body);
+        piece.active = false;
+        activeCount--;
+    }
+
+    // the body is out of the world: shape and mass can change without touching the broadphase
+    void setFragment(Debris &piece, int f, btScalar mass, const btTransform &transform) {
+        auto &fragment = Pattern.Fragments[f];
+        btRigidBody *body = piece.body;
+        btVector3 localInertia;
+        fragment.Shape->calculateLocalInertia(mass, localInertia);
+        body->setCollisionShape(fragment.Shape);
+        body->setMassProps(mass, localInertia);
+        body->setWorldTransform(transform);
+        body->getMotionState()->setWorldTransform(transform);
+        body->setInterpolationWorldTransform(transform);
+        body->updateInertiaTensor();
+        piece.fragment = f;
+    }
+
+    void breakProp(Prop &prop) {
+        prop.pending = false;
+        prop.broken = true;
+        brokenCount++;
+        btRigidBody *body = prop.body;
+        btTransform transform = body->getWorldTransform();
+        btVector3 linearVelocity = body->getLinearVelocity(), angularVelocity = body->getAngularVelocity();
+        btScalar mass = body->getInvMass() > 0 ? 1.f / body->getInvMass() : 1.f;
+        simulation.dynamicsWorld->removeRigidBody(body);
+
+        for(int f = 0; f < Pattern.Fragments.size(); f++) {
+            auto &fragment = Pattern.Fragments[f];
+            Debris &piece = takeDebris();
+            btRigidBody *pieceBody = piece.body;
+
+            btTransform pieceTransform = transform * btTransform(btQuaternion::getIdentity(), fragment.Offset);
+            setFragment(piece, f, mass * fragment.VolumeFraction, pieceTransform);
+
+            // the velocity of the point of the box where the fragment was, plus the burst
+            btVector3 arm = pieceTransform.getOrigin() - transform.getOrigin();
+            btVector3 burst = arm.fuzzyZero() ? btVector3(0, 0, 0) : arm.normalized() * BurstSpeed;
+            pieceBody->setLinearVelocity(linearVelocity + angularVelocity.cross(arm) + burst);
+            pieceBody->setAngularVelocity(angularVelocity);
+            pieceBody->clearForces();
+
+            simulation.AddRigidBody(pieceBody, COLLISION_DEBRIS);
+            pieceBody->forceActivationState(ACTIVE_TAG);
+            pieceBody->activate(true);
+            piece.age = 0.f;
+            piece.active = true;
+            activeCount++;
+        }
+    }
+};
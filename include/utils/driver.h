@@ -0,0 +1,160 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include "./vehicle.h"
+#include "./racing_line.h"
+
+// when the car stays upside down (or on a side) for rolloverTime it is put back on its wheels, returns true then
+bool recoverRollover(Vehicle &vehicle, float deltaTime, float rolloverTime, float &upsideDownTime) {
+    btVector3 up = vehicle.GetBulletVehicle().getChassisWorldTransform().getBasis().getColumn(1);
+    if(up.getY() >= .2f) {
+        upsideDownTime = 0.f;
+        return false;
+    }
+    upsideDownTime += deltaTime;
+    if(upsideDownTime <= rolloverTime) return false;
+    upsideDownTime = 0.f;
+    vehicle.ResetRotation();
+    return true;
+}
+
+// waypoints of a circular lap that starts (and ends) at the spawn position of the vehicle:
+// the circle is on the right of the vehicle and it's tangent to its initial direction (+z)
+std::vector<glm::vec3> circuitWaypoints(float radius, int count) {
+    std::vector<glm::vec3> waypoints;
+    glm::vec3 center(-radius, 0.f, 0.f);
+    for(int i = 1; i <= count; i++) {
+        float angle = 2.f * glm::pi<float>() * i / count;
+        waypoints.push_back(center + radius * glm::vec3(cos(angle), 0.f, sin(angle)));
+    }
+    return waypoints;
+}
+
+// Scripted driver: drives the vehicle through a list of waypoints using the same commands of the
+// player (accelerate, decelerate, steer), so different vehicle setups can be compared on the same lap.
+// It also counts the rollovers: when the car stays upside down it is put back on its wheels.
+class WaypointDriver {
+public:
+    WaypointDriver(const std::vector<glm::vec3> &waypoints, float reachRadius = 10.f): ReachRadius(reachRadius), waypoints(waypoints) {}
+
+    // gives the commands of a frame to the vehicle, returns true when the last waypoint is reached
+    bool Drive(Vehicle &vehicle, float deltaTime) {
+        if(LapCompleted()) return true;
+        auto &bulletVehicle = vehicle.GetBulletVehicle();
+        btTransform chassisTransform = bulletVehicle.getChassisWorldTransform();
+        btVector3 position = chassisTransform.getOrigin();
+
+        auto &waypoint = waypoints[CurrentWaypoint];
+        btVector3 target(waypoint.x, position.getY(), waypoint.z);
+        if(position.distance(target) < ReachRadius) {
+            CurrentWaypoint++;
+            if(LapCompleted()) return true;
+            return false;
+        }
+
+        // direction of the waypoint in the space of the chassis: forward is +z and left is +x
+        btVector3 localTarget = chassisTransform.invXform(target);
+        float angle = atan2(localTarget.getX(), localTarget.getZ());
+        if(angle > SteeringDeadZone)
+            vehicle.SteerLeft(deltaTime);
+        else if(angle < -SteeringDeadZone)
+            vehicle.SteerRight(deltaTime);
+
+        // slow down before the sharp turns
+        if(fabs(angle) > BrakingAngle && vehicle.GetSpeed() > TurnSpeed)
+            vehicle.Decelerate();
+        else
+            vehicle.Accelerate();
+
+        if(recoverRollover(vehicle, deltaTime, RolloverTime, upsideDownTime)) Rollovers++;
+        return false;
+    }
+
+    bool LapCompleted() {
+        return CurrentWaypoint >= waypoints.size();
+    }
+
+    int CurrentWaypoint = 0;
+    int Rollovers = 0;
+    // distance to consider a waypoint reached
+    float ReachRadius;
+    // angle of the waypoint (radians) under which the driver goes straight
+    float SteeringDeadZone = .05f;
+    // over this angle the driver slows down to the TurnSpeed (Km/h)
+    float BrakingAngle = .6f;
+    float TurnSpeed = 50.f;
+    // seconds upside down before a rollover is counted
+    float RolloverTime = 1.f;
+
+private:
+    std::vector<glm::vec3> waypoints;
+    float upsideDownTime = 0.f;
+};
+
+// AI driver following a RacingLine: it steers toward a point of the line ahead of the closest one (farther at
+// higher speed), shifted by Offset to the right of the line, and slows down when the line turns ahead.
+// Drive only reads the line and changes the commands of its own vehicle, so the drivers of different vehicles
+// can run at the same time on different threads.
+class RacingLineDriver {
+public:
+    void Drive(Vehicle &vehicle, const RacingLine &line, float deltaTime) {
+        btTransform chassisTransform = vehicle.GetBulletVehicle().getChassisWorldTransform();
+        btVector3 position = chassisTransform.getOrigin();
+
+        float progress = line.ClosestDistance(glm::vec3(position.getX(), position.getY(), position.getZ()));
+        // the line starts again after the finish, the progress jumps back of (almost) a lap
+        if(progress < Progress - line.Length() * .5f) Laps++;
+        Progress = progress;
+
+        float speed = vehicle.GetSpeed();
+        float targetDistance = progress + LookAhead + LookAheadTime * fabs(speed) / 3.6f;
+        glm::vec3 direction = line.DirectionAt(targetDistance);
+        glm::vec3 target = line.PointAt(targetDistance) + glm::normalize(glm::vec3(-direction.z, 0.f, direction.x)) * Offset;
+
+        // direction of the target in the space of the chassis: forward is +z and left is +x
+        btVector3 localTarget = chassisTransform.invXform(btVector3(target.x, position.getY(), target.z));
+        float angle = atan2(localTarget.getX(), localTarget.getZ());
+        if(angle > SteeringDeadZone)
+            vehicle.SteerLeft(deltaTime);
+        else if(angle < -SteeringDeadZone)
+            vehicle.SteerRight(deltaTime);
+
+        // how much the line turns between here and the braking distance
+        float turn = acos(glm::clamp(glm::dot(line.DirectionAt(progress), line.DirectionAt(progress + BrakingDistance)), -1.f, 1.f));
+        if((turn > BrakingAngle && speed > TurnSpeed) || speed > MaxSpeed)
+            vehicle.Decelerate();
+        else
+            vehicle.Accelerate();
+
+        if(recoverRollover(vehicle, deltaTime, RolloverTime, upsideDownTime)) Rollovers++;
+    }
+
+    // distance along the line of the vehicle and completed laps
+    float Progress = 0.f;
+    int Laps = 0;
+    int Rollovers = 0;
+    // distance of the line followed to the right of the racing line, to keep the vehicles side by side
+    float Offset = 0.f;
+    // the target is LookAhead meters ahead on the line, plus the distance covered in LookAheadTime seconds
+    float LookAhead = 6.f;
+    float LookAheadTime = .5f;
+    // angle of the target (radians) under which the driver goes straight
+    float SteeringDeadZone = .05f;
+    // when the line turns more than BrakingAngle in the next BrakingDistance meters the driver slows down to TurnSpeed (Km/h)
+    float BrakingDistance = 30.f;
+    float BrakingAngle = .5f;
+    float TurnSpeed = 60.f;
+    float MaxSpeed = 120.f;
+    // seconds upside down before a rollover is counted
+    float RolloverTime = 1.f;
+
+private:
+    float upsideDownTime = 0.f;
+};
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include "./mesh.h"
+#include "./physics.h"
+
+// one piece of a fractured box, in its own frame centered on its center of mass
+struct Fragment {
+    btConvexHullShape *Shape;
+    // center of mass of the fragment in the frame of the box
+    btVector3 Offset;
+    // part of the volume of the box, the mass of the fragment is the same part of the mass of the box
+    float VolumeFraction;
+    // flat shaded faces of the fragment, to draw it
+    Mesh Geometry;
+};
+
+// Fracture pattern of a box, baked once when the game is loaded: the box is split in the Voronoi cells of
+// random points inside it. Each cell is the intersection of the planes of the box with the planes halfway
+// between its point and the other ones, so it's convex and it becomes a btConvexHullShape.
+// All the boxes with the same size share the pattern (shapes and meshes).
+class FracturedBox {
+public:
+    FracturedBox(Physics &simulation, const glm::vec3 &halfExtents, int count = 8, unsigned int seed = 1, bool uploadToGPU = true): HalfExtents(halfExtents) {
+        // the same pattern at each run (e.g. for the replays)
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<float> unit(-.9f, .9f);
+        std::vector<glm::vec3> seeds(count);
+        for(auto &point: seeds) {
+            point = glm::vec3(unit(generator), unit(generator), unit(generator)) * halfExtents;
+        }
+
+        PhysicsAllocator::Scope memoryScope(MEMORY_SHAPES);
+        Fragments.reserve(count);
+        float boxVolume = 8.f * halfExtents.x * halfExtents.y * halfExtents.z;
+        for(int i = 0; i < count; i++) {
+            std::vector<Plane> planes {
+                {glm::vec3(1.f, 0.f, 0.f), halfExtents.x}, {glm::vec3(-1.f, 0.f, 0.f), halfExtents.x},
+                {glm::vec3(0.f, 1.f, 0.f), halfExtents.y}, {glm::vec3(0.f, -1.f, 0.f), halfExtents.y},
+                {glm::vec3(0.f, 0.f, 1.f), halfExtents.z}, {glm::vec3(0.f, 0.f, -1.f), halfExtents.z},
+            };
+            for(int j = 0; j < count; j++) {
+                if(j == i || glm::length(seeds[j] - seeds[i]) < 1e-4f) continue;
+                glm::vec3 normal = glm::normalize(seeds[j] - seeds[i]);
+                planes.push_back({normal, glm::dot(normal, (seeds[i] + seeds[j]) * .5f)});
+            }
+            addCell(simulation, planes, boxVolume, uploadToGPU);
+        }
+    }
+
+    FracturedBox(const FracturedBox& copy) = delete; //disallow copy
+    FracturedBox& operator=(const FracturedBox &) = delete;
+
+    glm::vec3 HalfExtents;
+    std::vector<Fragment> Fragments;
+
+private:
+    // plane of a cell, a point is inside when dot(normal, point) <= distance
+    struct Plane {
+        glm::vec3 normal;
+        float distance;
+    };
+
+    void addCell(Physics &simulation, const std::vector<Plane> &planes, float boxVolume, bool uploadToGPU) {
+        const float epsilon = 1e-4f;
+        // the vertices of the cell are the intersections of three planes inside all the other ones
+        std::vector<glm::vec3> points;
+        int numPlanes = planes.size();
+        for(int a = 0; a < numPlanes; a++) {
+            for(int b = a + 1; b < numPlanes; b++) {
+                for(int c = b + 1; c < numPlanes; c++) {
+                    // rows of the system are the normals (glm matrices are column major)
+                    glm::mat3 system = glm::transpose(glm::mat3(planes[a].normal, planes[b].normal, planes[c].normal));
+                    if(std::abs(glm::determinant(system)) < 1e-6f) continue;
+                    glm::vec3 point = glm::inverse(system) * glm::vec3(planes[a].distance, planes[b].distance, planes[c].distance);
+                    bool inside = std::all_of(planes.begin(), planes.end(), [&](const Plane &plane) {
+                        return glm::dot(plane.normal, point) <= plane.distance + epsilon;
+                    });
+                    bool duplicated = std::any_of(points.begin(), points.end(), [&](const glm::vec3 &other) {
+                        return glm::length(other - point) < epsilon;
+                    });
+                    if(inside && !duplicated) points.push_back(point);
+                }
+            }
+        }
+        if(points.size() < 4) return;
+
+        // the faces are the polygons of the vertices on each plane, sorted around the center of the face
+        glm::vec3 inner(0.f);
+        for(auto &point: points) inner += point;
+        inner /= (float) points.size();
+        std::vector<std::vector<glm::vec3>> faces;
+        std::vector<glm::vec3> faceNormals;
+        for(auto &plane: planes) {
+            std::vector<glm::vec3> face;
+            for(auto &point: points) {
+                if(std::abs(glm::dot(plane.normal, point) - plane.distance) < epsilon) face.push_back(point);
+            }
+            if(face.size() < 3) continue;
+            glm::vec3 center(0.f);
+            for(auto &point: face) center += point;
+            center /= (float) face.size();
+            glm::vec3 u = glm::normalize(face[0] - center), v = glm::cross(plane.normal, u);
+            // counterclockwise seen from outside the cell
+            std::sort(face.begin(), face.end(), [&](const glm::vec3 &p, const glm::vec3 &q) {
+                return std::atan2(glm::dot(p - center, v), glm::dot(p - center, u)) < std::atan2(glm::dot(q - center, v), glm::dot(q - center, u));
+            });
+            faces.push_back(face);
+            faceNormals.push_back(plane.normal);
+        }
+
+        // volume and center of mass from the tetrahedra between the inner point and the triangles of the faces
+        float volume = 0.f;
+        glm::vec3 centerOfMass(0.f);
+        for(auto &face: faces) {
+            for(int k = 1; k + 1 < face.size(); k++) {
+                float tetrahedron = glm::dot(face[0] - inner, glm::cross(face[k] - inner, face[k + 1] - inner)) / 6.f;
+                volume += tetrahedron;
+                centerOfMass += tetrahedron * (inner + face[0] + face[k] + face[k + 1]) / 4.f;
+            }
+        }
+        if(volume <= 0.f) return;
+        centerOfMass /= volume;
+
+        std::vector<Vertex> vertices;
+        std::vector<GLuint> indices;
+        for(int f = 0; f < faces.size(); f++) {
+            GLuint first = vertices.size();
+            for(auto &point: faces[f]) {
+                Vertex vertex = {};
+                vertex.Position = point - centerOfMass;
+                vertex.Normal = faceNormals[f];
+                vertices.push_back(vertex);
+            }
+            for(GLuint k = 1; k + 1 < faces[f].size(); k++) {
+                indices.insert(indices.end(), {first, first + k, first + k + 1});
+            }
+        }
+
+        auto shape = new btConvexHullShape();
+        for(auto &point: points) {
+            glm::vec3 local = point - centerOfMass;
+            shape->addPoint(btVector3(local.x, local.y, local.z), false);
+        }
+        shape->recalcLocalAabb();
+        // a small margin, the fragments are spawned touching each other
+        shape->setMargin(.01f);
+        simulation.collisionShapes.push_back(shape);
+
+        Fragments.push_back(Fragment{shape, btVector3(centerOfMass.x, centerOfMass.y, centerOfMass.z), volume / boxVolume,
+                                     Mesh(vertices, indices, uploadToGPU)});
+    }
+};
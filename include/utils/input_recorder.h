@@ -0,0 +1,143 @@
+#pragma once
+
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+// version of the file format, increase it when the format changes
+constexpr uint32_t INPUT_RECORDING_VERSION = 2;
+const char INPUT_RECORDING_MAGIC[4] = {'C', 'R', 'I', 'N'};
+
+// Recorder of the input of a run, to replay exactly the same run on different builds.
+// The input of each frame is a bitmask of the keys used by the game (the mapping between keys
+// and bits is chosen by the application), and each frame is simulated with the same fixed tick.
+// Consecutive frames with the same input are stored as a single run, so the file is very small.
+// File format (little endian):
+//     magic "CRIN", version, random seed, tick (float), number of frames, number of runs,
+//     and then for each run: number of frames (uint16) and input state (uint16)
+class InputRecorder {
+public:
+    // starts a new recording, the file is written by Stop
+    void StartRecording(const char *path, uint32_t seed, float tick) {
+        filePath = path;
+        Seed = seed;
+        Tick = tick;
+        runs.clear();
+        Frames = 0;
+        recording = true;
+    }
+
+    // loads a recorded run, then the input of each frame is returned by NextState
+    bool LoadReplay(const char *path) {
+        FILE *file = fopen(path, "rb");
+        if(!file) {
+            printf("Unable to open the input recording %s\n", path);
+            return false;
+        }
+        char magic[4];
+        uint32_t version, runCount;
+        bool valid = fread(magic, 1, 4, file) == 4 && memcmp(magic, INPUT_RECORDING_MAGIC, 4) == 0 &&
+                     fread(&version, sizeof(version), 1, file) == 1 && version == INPUT_RECORDING_VERSION &&
+                     fread(&Seed, sizeof(Seed), 1, file) == 1 &&
+                     fread(&Tick, sizeof(Tick), 1, file) == 1 &&
+                     fread(&Frames, sizeof(Frames), 1, file) == 1 &&
+                     fread(&runCount, sizeof(runCount), 1, file) == 1;
+        runs.clear();
+        for(uint32_t i = 0; valid && i < runCount; i++) {
+            Run run;
+            valid = fread(&run.length, sizeof(run.length), 1, file) == 1 &&
+                    fread(&run.state, sizeof(run.state), 1, file) == 1;
+            runs.push_back(run);
+        }
+        fclose(file);
+        if(!valid) {
+            printf("Invalid input recording %s\n", path);
+            return false;
+        }
+        currentRun = 0;
+        currentFrame = 0;
+        replaying = true;
+        return true;
+    }
+
+    // adds the input of a frame to the recording
+    void Record(uint16_t state) {
+        if(!recording) return;
+        if(!runs.empty() && runs.back().state == state && runs.back().length < UINT16_MAX) {
+            runs.back().length++;
+        } else {
+            runs.push_back(Run{1, state});
+        }
+        Frames++;
+    }
+
+    // input of the next frame of the replay, 0 (no key pressed) when the replay is finished
+    uint16_t NextState() {
+        if(Finished()) return 0;
+        auto &run = runs[currentRun];
+        uint16_t state = run.state;
+        currentFrame++;
+        if(currentFrame >= run.length) {
+            currentRun++;
+            currentFrame = 0;
+        }
+        return state;
+    }
+
+    bool Finished() {
+        return currentRun >= runs.size();
+    }
+
+    // writes the recorded run to the file
+    bool Stop() {
+        if(!recording) return true;
+        recording = false;
+        FILE *file = fopen(filePath, "wb");
+        if(!file) {
+            printf("Unable to write the input recording %s\n", filePath);
+            return false;
+        }
+        uint32_t runCount = runs.size();
+        fwrite(INPUT_RECORDING_MAGIC, 1, 4, file);
+        fwrite(&INPUT_RECORDING_VERSION, sizeof(INPUT_RECORDING_VERSION), 1, file);
+        fwrite(&Seed, sizeof(Seed), 1, file);
+        fwrite(&Tick, sizeof(Tick), 1, file);
+        fwrite(&Frames, sizeof(Frames), 1, file);
+        fwrite(&runCount, sizeof(runCount), 1, file);
+        for(auto &run: runs) {
+            fwrite(&run.length, sizeof(run.length), 1, file);
+            fwrite(&run.state, sizeof(run.state), 1, file);
+        }
+        fclose(file);
+        printf("Recorded %u frames (%u runs) in %s\n", Frames, runCount, filePath);
+        return true;
+    }
+
+    bool IsRecording() {
+        return recording;
+    }
+
+    bool IsReplaying() {
+        return replaying;
+    }
+
+    // seed of the random generator used during the run
+    uint32_t Seed = 0;
+    // fixed time of the simulation step of each frame (s)
+    float Tick = 1.f / 90.f;
+    uint32_t Frames = 0;
+
+private:
+    struct Run {
+        uint16_t length;
+        uint16_t state;
+    };
+
+    const char *filePath = nullptr;
+    std::vector<Run> runs;
+    bool recording = false;
+    bool replaying = false;
+    size_t currentRun = 0;
+    int currentFrame = 0;
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <vector>
+
+#include <bullet/btBulletDynamicsCommon.h>
+#include <bullet/BulletCollision/CollisionDispatch/btGhostObject.h>
+
+#include "./physics.h"
+
+// state of the timer, saved by a WorldSnapshot: a restored snapshot brings back also the lap in progress
+struct LapTimerState {
+    bool started;
+    int laps;
+    int nextCheckpoint;
+    int currentSector;
+    float lastLapTime, bestLapTime;
+    std::vector<float> sectorTimes, bestSectorTimes;
+    float time, lapStart, sectorStart;
+};
+
+// Lap and sector times of a vehicle crossing a sequence of checkpoints.
+// Each checkpoint is a box trigger (btPairCachingGhostObject): the broadphase keeps the objects overlapping it,
+// updated only when a pair is added or removed. After each internal step only the next checkpoint of the
+// sequence is checked, walking its overlapping objects: the cost doesn't grow with the checkpoints of the track.
+// The first checkpoint is the start/finish line: the timer starts crossing it, then the other ones must be
+// crossed in order before crossing it again to complete the lap. The checkpoints marked as end of a sector split
+// the lap in sectors (the last sector ends at the finish line).
+// Times are in seconds of simulation, summing the internal steps, so they are the same in the replays.
+class LapTimer {
+public:
+    LapTimer(Physics &simulation, const btCollisionObject *vehicle): simulation(simulation), vehicle(vehicle) {
+        tickCallback = simulation.AddTickCallback([this](btScalar timeStep) { tick(timeStep); });
+    }
+
+    ~LapTimer() {
+        simulation.RemoveTickCallback(tickCallback);
+    }
+
+    LapTimer(const LapTimer& copy) = delete; //disallow copy
+    LapTimer& operator=(const LapTimer &) = delete;
+
+    // adds a gate at the end of the sequence: halfExtents are across the track (x), up (y) and along the
+    // track (z), rotated around the vertical axis by yaw. Ghosts and shapes are deallocated by the world
+    void AddCheckpoint(const btVector3 &position, const btVector3 &halfExtents, btScalar yaw, bool sectorEnd = false) {
+        auto shape = new btBoxShape(halfExtents);
+        simulation.collisionShapes.push_back(shape);
+        auto ghost = new btPairCachingGhostObject();
+        ghost->setCollisionShape(shape);
+        ghost->setWorldTransform(btTransform(btQuaternion(btVector3(0, 1, 0), yaw), position));
+        simulation.AddGhostObject(ghost, COLLISION_TRIGGER);
+        // the start line can't end a sector
+        sectorEnd = sectorEnd && !checkpoints.empty();
+        checkpoints.push_back(Checkpoint{ghost, halfExtents, sectorEnd});
+        if(sectorEnd) {
+            SectorTimes.push_back(0.f);
+            BestSectorTimes.push_back(-1.f);
+        }
+    }
+
+    // the timer waits again for the start line, the best times are kept
+    void Reset() {
+        Started = false;
+        NextCheckpoint = 0;
+        CurrentSector = 0;
+    }
+
+    void SaveState(LapTimerState &state) {
+        state = LapTimerState{Started, Laps, NextCheckpoint, CurrentSector, LastLapTime, BestLapTime,
+                              SectorTimes, BestSectorTimes, time, lapStart, sectorStart};
+    }
+
+    void RestoreState(const LapTimerState &state) {
+        // a state saved before some sectors were added can't be restored
+        if(state.sectorTimes.size() != SectorTimes.size()) return;
+        Started = state.started;
+        Laps = state.laps;
+        NextCheckpoint = state.nextCheckpoint;
+        CurrentSector = state.currentSector;
+        LastLapTime = state.lastLapTime;
+        BestLapTime = state.bestLapTime;
+        SectorTimes = state.sectorTimes;
+        BestSectorTimes = state.bestSectorTimes;
+        time = state.time;
+        lapStart = state.lapStart;
+        sectorStart = state.sectorStart;
+    }
+
+    int CheckpointCount() {
+        return checkpoints.size();
+    }
+
+    float CurrentLapTime() {
+        return Started ? time - lapStart : 0.f;
+    }
+
+    // the vehicle crossed the start line
+    bool Started = false;
+    // completed laps
+    int Laps = 0;
+    // index of the checkpoint to cross
+    int NextCheckpoint = 0;
+    // negative if there isn't a time yet
+    float LastLapTime = -1.f;
+    float BestLapTime = -1.f;
+    // times of the sectors of the current lap (the ones completed), and the best ones
+    // (the last one is the sector ending at the finish line)
+    std::vector<float> SectorTimes = {0.f};
+    std::vector<float> BestSectorTimes = {-1.f};
+    int CurrentSector = 0;
+
+private:
+    struct Checkpoint {
+        btPairCachingGhostObject *ghost;
+        btVector3 halfExtents;
+        bool sectorEnd;
+    };
+
+    Physics &simulation;
+    const btCollisionObject *vehicle;
+    int tickCallback;
+    std::vector<Checkpoint> checkpoints;
+    // simulation time, of the start of the lap and of the current sector
+    float time = 0.f;
+    float lapStart = 0.f;
+    float sectorStart = 0.f;
+
+    // the vehicle overlaps the AABB of the ghost, and its center is inside the box of the gate
+    bool crossing(const Checkpoint &checkpoint) {
+        auto ghost = checkpoint.ghost;
+        for(int i = 0; i < ghost->getNumOverlappingObjects(); i++) {
+            if(ghost->getOverlappingObject(i) != vehicle) continue;
+            btVector3 local = ghost->getWorldTransform().invXform(vehicle->getWorldTransform().getOrigin());
+            return btFabs(local.x()) <= checkpoint.halfExtents.x() && btFabs(local.y()) <= checkpoint.halfExtents.y() &&
+                   btFabs(local.z()) <= checkpoint.halfExtents.z();
+        }
+        return false;
+    }
+
+    void endSector() {
+        float sectorTime = time - sectorStart;
+        SectorTimes[CurrentSector] = sectorTime;
+        if(BestSectorTimes[CurrentSector] < 0.f || sectorTime < BestSectorTimes[CurrentSector])
+            BestSectorTimes[CurrentSector] = sectorTime;
+        sectorStart = time;
+        CurrentSector = (CurrentSector + 1) % SectorTimes.size();
+    }
+
+    void tick(btScalar timeStep) {
+        time += timeStep;
+        // a lap needs at least the start line and another checkpoint
+        if(checkpoints.size() < 2 || !crossing(checkpoints[NextCheckpoint])) return;
+
+        if(!Started) {
+            Started = true;
+            lapStart = sectorStart = time;
+        } else if(NextCheckpoint == 0) {
+            endSector();
+            LastLapTime = time - lapStart;
+            if(BestLapTime < 0.f || LastLapTime < BestLapTime) BestLapTime = LastLapTime;
+            Laps++;
+            lapStart = time;
+        } else if(checkpoints[NextCheckpoint].sectorEnd) {
+            endSector();
+        }
+        NextCheckpoint = (NextCheckpoint + 1) % checkpoints.size();
+    }
+};
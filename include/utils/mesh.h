@@ -67,10 +67,13 @@ public:
     // Constructor
     // We use initializer list and std::move in order to avoid a copy of the arguments
     // This constructor empties the source vectors (vertices and indices)
-    Mesh(vector<Vertex>& vertices, vector<GLuint>& indices) noexcept
-        : vertices(std::move(vertices)), indices(std::move(indices))
+    // if uploadToGPU is false the buffers are not created (e.g. the mesh is used only by the physics
+    // simulation and there isn't an OpenGL context), in this case the mesh can't be drawn
+    Mesh(vector<Vertex>& vertices, vector<GLuint>& indices, bool uploadToGPU = true) noexcept
+        : vertices(std::move(vertices)), indices(std::move(indices)), VAO(0)
     {
-        this->setupMesh();
+        if(uploadToGPU)
+            this->setupMesh();
     }
 
     // We implement a user-defined move constructor and move assignment
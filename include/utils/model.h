@@ -68,7 +68,8 @@ public:
     // to notice that Model class is not strictly following the Rules of 5
     // https://en.cppreference.com/w/cpp/language/rule_of_three
     // because we are not writing a user-defined destructor.
-    Model(const string& path)
+    // if uploadToGPU is false only the CPU side of the meshes is loaded (see Mesh constructor)
+    Model(const string& path, bool uploadToGPU = true): uploadToGPU(uploadToGPU)
     {
         this->loadModel(path);
     }
@@ -86,6 +87,8 @@ public:
 
 
 private:
+    // if the meshes should create their OpenGL buffers
+    bool uploadToGPU;
 
     //////////////////////////////////////////
     // loading of the model using Assimp library. Nodes are processed to build a vector of Mesh class instances
@@ -202,6 +205,6 @@ private:
         }
 
         // we return an instance of the Mesh class created using the vertices and faces data structures we have created above.
-        return Mesh(vertices, indices);
+        return Mesh(vertices, indices, uploadToGPU);
     }
 };
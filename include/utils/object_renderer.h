@@ -38,6 +38,14 @@ class ObjectRenderer: public Renderer {
         glUniformMatrix3fv(glGetUniformLocation(shader->Program, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
     }
 
+    // with the inverse transpose of the model already computed (see RenderMotionState): the view is a rigid
+    // transformation, so its inverse transpose is the view itself
+    void SetModelTrasformation(const glm::mat4 &modelMatrix, const glm::mat3 &modelNormalMatrix) {
+        glm::mat3 normalMatrix = glm::mat3(view) * modelNormalMatrix;
+        glUniformMatrix4fv(glGetUniformLocation(shader->Program, "modelMatrix"), 1, GL_FALSE, glm::value_ptr(modelMatrix));
+        glUniformMatrix3fv(glGetUniformLocation(shader->Program, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
+    }
+
     virtual void SetColor(glm::vec3 color) = 0;
     
     virtual void SetTexture(Texture &texture, float repeat=1.f) = 0;
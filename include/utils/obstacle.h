@@ -6,28 +6,22 @@
 
 class Obstacle {
 public:
-    Obstacle(Model *model, glm::vec3 pos, glm::vec3 dim=glm::vec3(1.f, 1.f, 1.f)): Model(model), Position(pos), Dimension(dim) {
+    Obstacle(Physics &simulation, Model *model, glm::vec3 pos, glm::vec3 dim=glm::vec3(1.f, 1.f, 1.f)): Model(model), Position(pos), Dimension(dim) {
         glm::vec3 rot = glm::vec3(0.0f, 0.0f, 0.0f);
-        auto &simulation = Physics::GetInstance();
-        // create one rigid body for mesh
-        for(auto &mesh: Model->meshes) {
-            auto rigidBody = simulation.createRigidBodyFromMesh(mesh, pos, rot, dim);
-            rigidBodies.push_back(rigidBody);
-        }
+        // one static rigid body for the whole model, also when it's made of several meshes
+        rigidBody = simulation.createRigidBodyFromModel(Model, pos, rot, dim);
     }
 
     void Draw(ObjectRenderer &renderer) {
-        float matrix[16];
-        btTransform transform;
         renderer.UpdateIlluminationModel(Illumination);
-        for(auto rigidBody: rigidBodies) {
-            rigidBody->getMotionState()->getWorldTransform(transform);
-            transform.getOpenGLMatrix(matrix);
-            auto modelMatrix = glm::make_mat4(matrix);
-            modelMatrix = glm::scale(modelMatrix, Dimension);
-            renderer.SetModelTrasformation(modelMatrix);
-            Model->Draw();
-        }
+        // the obstacle is static, its matrices are computed only once
+        auto motionState = (RenderMotionState*) rigidBody->getMotionState();
+        renderer.SetModelTrasformation(motionState->ModelMatrix(Dimension), motionState->ModelNormalMatrix(Dimension));
+        Model->Draw();
+    }
+
+    btRigidBody *GetRigidBody() {
+        return rigidBody;
     }
 
     Obstacle(const Obstacle& copy) = delete; //disallow copy
@@ -43,5 +37,5 @@ public:
 private:
     // bullet object created by the physics class are deallocated by the world
     // object without the necessity to do that here
-    std::vector<btRigidBody*> rigidBodies;
+    btRigidBody *rigidBody;
 };
\ No newline at end of file
@@ -16,22 +16,172 @@ Universita' degli Studi di Milano
 #pragma once
 
 #include <bullet/btBulletDynamicsCommon.h>
+#include <bullet/BulletCollision/CollisionShapes/btShapeHull.h>
+#include <bullet/BulletCollision/BroadphaseCollision/btAxisSweep3.h>
+#include <bullet/BulletCollision/CollisionDispatch/btGhostObject.h>
+
+#include <map>
+#include <tuple>
+#include <vector>
+#include <functional>
+
+#include "./physics_allocator.h"
+#include "./render_motion_state.h"
 
 //enum to identify the 2 considered Collision Shapes
 enum shapes{ BOX, SPHERE};
 
+// maximum number of points of the convex hulls generated from models, a bigger hull
+// makes the narrowphase (GJK/EPA) more expensive without a visible difference in the simulation
+const int MAX_HULL_POINTS = 64;
+
+// collision categories of the bodies: two bodies collide only if each one has the category of the other in its mask.
+// The first bits are the ones of Bullet (btBroadphaseProxy::CollisionFilterGroups), so the default ray queries
+// (the wheels of the vehicles) have the COLLISION_RAY category
+enum CollisionGroup {
+    // the category is chosen by the mass: static world or prop
+    COLLISION_AUTO = 0,
+    COLLISION_RAY = btBroadphaseProxy::DefaultFilter,
+    COLLISION_STATIC = btBroadphaseProxy::StaticFilter,
+    COLLISION_DEBRIS = btBroadphaseProxy::DebrisFilter,
+    COLLISION_TRIGGER = btBroadphaseProxy::SensorTrigger,
+    COLLISION_VEHICLE = 1 << 6,
+    COLLISION_PROP = 1 << 7,
+    COLLISION_PROJECTILE = 1 << 8,
+};
+
+// mask to use the default mask of the category
+const int COLLISION_GROUP_MASK = 0;
+
+// default masks of the categories: the static world doesn't test pairs with itself, projectiles don't hit each other
+// and are ignored by the wheels, debris touches only the static world and triggers only vehicles and props
+int collisionMask(int group) {
+    switch(group) {
+        case COLLISION_STATIC: return COLLISION_RAY | COLLISION_DEBRIS | COLLISION_VEHICLE | COLLISION_PROP | COLLISION_PROJECTILE;
+        case COLLISION_DEBRIS: return COLLISION_STATIC;
+        case COLLISION_TRIGGER: return COLLISION_VEHICLE | COLLISION_PROP;
+        case COLLISION_VEHICLE: return COLLISION_RAY | COLLISION_STATIC | COLLISION_TRIGGER | COLLISION_VEHICLE | COLLISION_PROP | COLLISION_PROJECTILE;
+        case COLLISION_PROP: return COLLISION_RAY | COLLISION_STATIC | COLLISION_TRIGGER | COLLISION_VEHICLE | COLLISION_PROP | COLLISION_PROJECTILE;
+        case COLLISION_PROJECTILE: return COLLISION_STATIC | COLLISION_VEHICLE | COLLISION_PROP;
+        default: return btBroadphaseProxy::AllFilter;
+    }
+}
+
+// filter of the pairs found by the broadphase, the same test of Bullet on categories and masks, counting the pairs
+// discarded before the narrowphase.
+// N.B.) the pair cache calls the filter also for the pairs it already has (e.g. the dbvt adds again the pairs still
+// overlapping), so the counters are tests of the filter, not new overlaps
+struct PairFilter : public btOverlapFilterCallback {
+    bool needBroadphaseCollision(btBroadphaseProxy *proxy0, btBroadphaseProxy *proxy1) const override {
+        bool collides = (proxy0->m_collisionFilterGroup & proxy1->m_collisionFilterMask) != 0 &&
+                        (proxy1->m_collisionFilterGroup & proxy0->m_collisionFilterMask) != 0;
+        FilterCalls++;
+        if(!collides) CulledCalls++;
+        return collides;
+    }
+
+    // calls of the filter from the creation of the world, and the ones that discarded the pair
+    mutable long long FilterCalls = 0;
+    mutable long long CulledCalls = 0;
+};
+
+// broadphase of the world
+enum BroadphaseType { BROADPHASE_DBVT, BROADPHASE_AXIS_SWEEP };
+
+// configuration of the collision detection of a world, the defaults are the ones used by the game
+struct PhysicsConfig {
+    BroadphaseType Broadphase = BROADPHASE_DBVT;
+
+    // btDbvtBroadphase: percentage of the leaves of the dynamic and fixed trees reinserted (optimized)
+    // at each step, and of the pairs checked for removal. Objects not moving for a couple of steps
+    // are moved from the dynamic tree to the fixed one, so static meshes stay out of the dynamic tree.
+    int DbvtDynamicUpdates = 0;
+    int DbvtFixedUpdates = 1;
+    int DbvtCleanupUpdates = 10;
+    // the pairs between the dynamic and the fixed tree are searched once in the collide of the step,
+    // instead of every time a proxy moves
+    bool DbvtDeferredCollide = false;
+
+    // btAxisSweep3: the bounds of the world (objects outside are clamped at the border, so they
+    // overlap with everything there) and the maximum number of objects
+    btVector3 WorldMin = btVector3(-1000.f, -1000.f, -1000.f);
+    btVector3 WorldMax = btVector3(1000.f, 1000.f, 1000.f);
+    int MaxHandles = 16384;
+
+    // the AABBs of static and sleeping objects are not updated by each step (they don't move):
+    // who moves them must call updateSingleAabb (as WorldSnapshot does)
+    bool UpdateOnlyActiveAabbs = true;
+
+    // dynamic bodies slower than these velocities (m/s and rad/s) for 2 seconds fall asleep: they are not
+    // simulated nor drawn again until something hits them. A bit higher than the Bullet defaults (0.8 and 1),
+    // so the cubes and the pins knocked down by the car stop wobbling sooner
+    float LinearSleepingThreshold = 1.f;
+    float AngularSleepingThreshold = 1.2f;
+};
+
 ///////////////////  Physics class ///////////////////////
 class Physics
 {
 public:
-    // from https://stackoverflow.com/questions/1008019/c-singleton-design-pattern
-    static Physics& GetInstance()
+    //////////////////////////////////////////
+    // constructor
+    // we set all the classes needed for the physical simulation
+    // each instance is an independent world: the objects of the scene receive the world where they are created,
+    // and different worlds can be stepped at the same time from different threads
+    Physics(const PhysicsConfig &config = PhysicsConfig()): Config(config)
     {
-        // Instantiated on first use
-        static Physics instance; // Guaranteed to be destroyed
-        return instance;
+        // all the memory of Bullet comes from our allocator, so it must be installed before any allocation
+        PhysicsAllocator::Install();
+
+        // Collision configuration, to be used by the collision detection class
+        // collision configuration contains default setup for memory, collision setup. Advanced users can create their own configuration.
+        this->collisionConfiguration = new btDefaultCollisionConfiguration();
+
+        // default collision dispatcher (= collision detection method). For parallel processing you can use a diffent dispatcher (see Extras/BulletMultiThreaded)
+        this->dispatcher = new btCollisionDispatcher(this->collisionConfiguration);
+
+        // btDbvtBroadphase is a good general purpose broadphase. btAxisSweep3 can be faster for worlds with known bounds
+        // and objects that move a little at each step, but its cost grows with the number of objects moving together
+        if(config.Broadphase == BROADPHASE_AXIS_SWEEP) {
+            // the 16 bit version supports up to 32767 objects
+            if(config.MaxHandles < 32767)
+                this->overlappingPairCache = new btAxisSweep3(config.WorldMin, config.WorldMax, config.MaxHandles);
+            else
+                this->overlappingPairCache = new bt32BitAxisSweep3(config.WorldMin, config.WorldMax, config.MaxHandles);
+        } else {
+            auto dbvt = new btDbvtBroadphase();
+            dbvt->m_dupdates = config.DbvtDynamicUpdates;
+            dbvt->m_fupdates = config.DbvtFixedUpdates;
+            dbvt->m_cupdates = config.DbvtCleanupUpdates;
+            dbvt->m_deferedcollide = config.DbvtDeferredCollide;
+            this->overlappingPairCache = dbvt;
+        }
+
+        // we set a ODE solver, which considers forces, constraints, collisions etc., to calculate positions and rotations of the rigid bodies.
+        // the default constraint solver. For parallel processing you can use a different solver (see Extras/BulletMultiThreaded)
+        this->solver = new btSequentialImpulseConstraintSolver();
+
+        //  DynamicsWorld is the main class for the physical simulation
+        this->dynamicsWorld = new btDiscreteDynamicsWorld(this->dispatcher,this->overlappingPairCache,this->solver,this->collisionConfiguration);
 
+        // we set the gravity force
+        this->dynamicsWorld->setGravity(btVector3(0.0f, -9.82f, 0.0f));
+
+        // by default Bullet updates the AABBs of all the objects, also the static meshes of the scene
+        this->dynamicsWorld->setForceUpdateAllAabbs(!config.UpdateOnlyActiveAabbs);
+
+        this->dynamicsWorld->getPairCache()->setOverlapFilterCallback(&this->Pairs);
+
+        // Bullet has a single pre and post tick callback, the world calls all the ones added with AddTickCallback
+        this->dynamicsWorld->setInternalTickCallback(preTick, this, true);
+        this->dynamicsWorld->setInternalTickCallback(postTick, this, false);
     }
+
+    ~Physics()
+    {
+        Clear();
+    }
+
     Physics(Physics const&)        = delete;
     void operator=(Physics const&) = delete;
 
@@ -42,10 +192,12 @@ public:
     btCollisionDispatcher* dispatcher; // collision manager
     btBroadphaseInterface* overlappingPairCache; // method for the broadphase collision detection
     btSequentialImpulseConstraintSolver* solver; // constraints solver
+    const PhysicsConfig Config; // configuration used to create the world
+    PairFilter Pairs; // statistics of the pairs culled by the collision categories
 
 
     // TODO: unify this with createRigidBody
-    btRigidBody *localCreateRigidBody(btScalar mass, const btTransform& startTransform, btCollisionShape* shape)
+    btRigidBody *localCreateRigidBody(btScalar mass, const btTransform& startTransform, btCollisionShape* shape, int group = COLLISION_AUTO, int mask = COLLISION_GROUP_MASK)
     {
         btAssert((!shape || shape->getShapeType() != INVALID_SHAPE_PROXYTYPE));
 
@@ -56,76 +208,42 @@ public:
         if (isDynamic)
             shape->calculateLocalInertia(mass, localInertia);
 
+        PhysicsAllocator::Scope memoryScope(MEMORY_BODIES);
         //using motionstate is recommended, it provides interpolation capabilities, and only synchronizes 'active' objects
-        btDefaultMotionState* myMotionState = new btDefaultMotionState(startTransform);
+        RenderMotionState* myMotionState = new RenderMotionState(startTransform);
 
         btRigidBody::btRigidBodyConstructionInfo cInfo(mass, myMotionState, shape, localInertia);
+        cInfo.m_linearSleepingThreshold = Config.LinearSleepingThreshold;
+        cInfo.m_angularSleepingThreshold = Config.AngularSleepingThreshold;
 
         btRigidBody* body = new btRigidBody(cInfo);
         //body->setContactProcessingThreshold(m_defaultContactProcessingThreshold);
 
-        dynamicsWorld->addRigidBody(body);
+        AddRigidBody(body, group, mask);
         return body;
     }
 
-    btRigidBody* createRigidBodyFromMesh(Mesh &mesh, glm::vec3 pos, glm::vec3 rot, glm::vec3 scale=glm::vec3(1.f, 1.f, 1.f)) {
-
-        auto triangleMesh = new btTriangleMesh();
-        for(auto &vertex: mesh.vertices) {
-            auto vertexPos = vertex.Position;
-            triangleMesh->findOrAddVertex(btVector3(vertexPos.x, vertexPos.y, vertexPos.z), false);
-        }
-
-        for(int i = 0; i < mesh.indices.size(); i += 3) {
-            triangleMesh->addTriangleIndices(mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2]);
-        }
-
-        auto cShape = new btBvhTriangleMeshShape(triangleMesh, true, true);
-        cShape->setLocalScaling(btVector3(scale.x, scale.y, scale.z));
-        this->collisionShapes.push_back(cShape);
-
-        // we set a quaternion from the Euler angles passed as parameters
-        btQuaternion rotation;
-        rotation.setEuler(rot.x, rot.y, rot.z);
-        btVector3 position(pos.x, pos.y, pos.z);
-
-        // We set the initial transformations
-        btTransform objTransform;
-        objTransform.setIdentity();
-        objTransform.setRotation(rotation);
-        // we set the initial position (it must be equal to the position of the corresponding model of the scene)
-        objTransform.setOrigin(position);
-
-        // if it is dynamic (mass > 0) then we calculates local inertia
-        btVector3 localInertia(0.0f, 0.0f, 0.0f);
-
-        // we initialize the Motion State of the object on the basis of the transformations
-        // using the Motion State, the physical simulation will calculate the positions and rotations of the rigid body
-        btDefaultMotionState* motionState = new btDefaultMotionState(objTransform);
-        // we set the data structure for the rigid body, mass is always 0 for mesh object (bullet)
-        btRigidBody::btRigidBodyConstructionInfo rbInfo(0.f, motionState, cShape, localInertia);
-        // we create the rigid body
-        btRigidBody* body = new btRigidBody(rbInfo);
-
-        //add the body to the dynamics world
-        this->dynamicsWorld->addRigidBody(body);
-
-        // the function returns a pointer to the created rigid body
-        // in a standard simulation (e.g., only objects falling), it is not needed to have a reference to a single rigid body, but in some cases (e.g., the application of an impulse), it is needed.
-        return body;
+    btRigidBody* createRigidBodyFromMesh(Mesh &mesh, glm::vec3 pos, glm::vec3 rot, glm::vec3 scale=glm::vec3(1.f, 1.f, 1.f), int group = COLLISION_STATIC, int mask = COLLISION_GROUP_MASK) {
+        PhysicsAllocator::Scope memoryScope(MEMORY_SHAPES);
+        auto triangleMesh = new btTriangleIndexVertexArray();
+        triangleMesh->addIndexedMesh(indexedMeshFromMesh(mesh), PHY_INTEGER);
+        return createStaticRigidBodyFromTriangleMesh(triangleMesh, pos, rot, scale, group, mask);
     }
 
-    btRigidBody* createConvexDynamicRigidBodyFromModel(Model *model, glm::vec3 pos, glm::vec3 rot, glm::vec3 scale, float m, float friction, float restitution) {
-        auto hull = new btConvexHullShape();
+    // a single static rigid body for all the meshes of the model: each mesh is a separate part
+    // of the same triangle mesh, so the model has only one BVH and one broadphase proxy
+    btRigidBody* createRigidBodyFromModel(Model *model, glm::vec3 pos, glm::vec3 rot, glm::vec3 scale=glm::vec3(1.f, 1.f, 1.f), int group = COLLISION_STATIC, int mask = COLLISION_GROUP_MASK) {
+        PhysicsAllocator::Scope memoryScope(MEMORY_SHAPES);
+        auto triangleMesh = new btTriangleIndexVertexArray();
         for(auto &mesh: model->meshes) {
-            for(auto &vertex: mesh.vertices) {
-                auto vertexPos = vertex.Position;
-                hull->addPoint(btVector3(vertexPos.x, vertexPos.y, vertexPos.z));
-            }
+            triangleMesh->addIndexedMesh(indexedMeshFromMesh(mesh), PHY_INTEGER);
         }
+        return createStaticRigidBodyFromTriangleMesh(triangleMesh, pos, rot, scale, group, mask);
+    }
 
-        hull->setLocalScaling(btVector3(scale.x, scale.y, scale.z));
-        this->collisionShapes.push_back(hull);
+    btRigidBody* createConvexDynamicRigidBodyFromModel(Model *model, glm::vec3 pos, glm::vec3 rot, glm::vec3 scale, float m, float friction, float restitution, int group = COLLISION_AUTO, int mask = COLLISION_GROUP_MASK) {
+        // all the bodies created from the same model with the same scale share the same hull
+        auto hull = getSimplifiedHull(model, scale);
 
         // we set a quaternion from the Euler angles passed as parameters
         btQuaternion rotation;
@@ -145,19 +263,22 @@ public:
         if (isDynamic)
             hull->calculateLocalInertia(m, localInertia);
 
+        PhysicsAllocator::Scope memoryScope(MEMORY_BODIES);
         // we initialize the Motion State of the object on the basis of the transformations
         // using the Motion State, the physical simulation will calculate the positions and rotations of the rigid body
-        btDefaultMotionState* motionState = new btDefaultMotionState(objTransform);
+        RenderMotionState* motionState = new RenderMotionState(objTransform);
         // we set the data structure for the rigid body, mass is always 0 for mesh object (bullet)
         btRigidBody::btRigidBodyConstructionInfo rbInfo(m, motionState, hull, localInertia);
         // we set friction and restitution
         rbInfo.m_friction = friction;
         rbInfo.m_restitution = restitution;
+        rbInfo.m_linearSleepingThreshold = Config.LinearSleepingThreshold;
+        rbInfo.m_angularSleepingThreshold = Config.AngularSleepingThreshold;
         // we create the rigid body
         btRigidBody* body = new btRigidBody(rbInfo);
 
-        //add the body to the dynamics world
-        this->dynamicsWorld->addRigidBody(body);
+        //add the body to the dynamics world, with its collision category
+        AddRigidBody(body, group, mask);
 
         // the function returns a pointer to the created rigid body
         // in a standard simulation (e.g., only objects falling), it is not needed to have a reference to a single rigid body, but in some cases (e.g., the application of an impulse), it is needed.
@@ -167,9 +288,10 @@ public:
     //////////////////////////////////////////
     // Method for the creation of a rigid body, based on a Box or Sphere Collision Shape
     // The Collision Shape is a reference solid that approximates the shape of the actual object of the scene. The Physical simulation is applied to these solids, and the rotations and positions of these solids are used on the real models.
-    btRigidBody* createRigidBody(int type, glm::vec3 pos, glm::vec3 size, glm::vec3 rot, float m, float friction , float restitution)
+    btRigidBody* createRigidBody(int type, glm::vec3 pos, glm::vec3 size, glm::vec3 rot, float m, float friction , float restitution, int group = COLLISION_AUTO, int mask = COLLISION_GROUP_MASK)
     {
         btCollisionShape* cShape = NULL;
+        PhysicsAllocator::Scope shapeMemoryScope(MEMORY_SHAPES);
 
         // we convert the glm vector to a Bullet vector
         btVector3 position = btVector3(pos.x,pos.y,pos.z);
@@ -209,15 +331,18 @@ public:
         if (isDynamic)
             cShape->calculateLocalInertia(mass,localInertia);
 
+        PhysicsAllocator::Scope memoryScope(MEMORY_BODIES);
         // we initialize the Motion State of the object on the basis of the transformations
         // using the Motion State, the physical simulation will calculate the positions and rotations of the rigid body
-        btDefaultMotionState* motionState = new btDefaultMotionState(objTransform);
+        RenderMotionState* motionState = new RenderMotionState(objTransform);
 
         // we set the data structure for the rigid body
         btRigidBody::btRigidBodyConstructionInfo rbInfo(mass,motionState,cShape,localInertia);
         // we set friction and restitution
         rbInfo.m_friction = friction;
         rbInfo.m_restitution = restitution;
+        rbInfo.m_linearSleepingThreshold = Config.LinearSleepingThreshold;
+        rbInfo.m_angularSleepingThreshold = Config.AngularSleepingThreshold;
 
         // if the Collision Shape is a sphere
         if (type == SPHERE){
@@ -230,18 +355,70 @@ public:
         // we create the rigid body
         btRigidBody* body = new btRigidBody(rbInfo);
 
-        //add the body to the dynamics world
-        this->dynamicsWorld->addRigidBody(body);
+        //add the body to the dynamics world, with its collision category
+        AddRigidBody(body, group, mask);
 
         // the function returns a pointer to the created rigid body
         // in a standard simulation (e.g., only objects falling), it is not needed to have a reference to a single rigid body, but in some cases (e.g., the application of an impulse), it is needed.
         return body;
     }
 
+    //////////////////////////////////////////
+    // functions called before (preTick) or after each internal step of stepSimulation, with the fixed timestep:
+    // with substeps they are called more times in a frame. Returns the id to remove the callback
+    typedef std::function<void(btScalar)> TickCallback;
+
+    int AddTickCallback(const TickCallback &callback, bool preTick = false) {
+        int id = nextTickCallbackId++;
+        (preTick ? preTickCallbacks : postTickCallbacks).push_back(std::make_pair(id, callback));
+        return id;
+    }
+
+    void RemoveTickCallback(int id) {
+        for(auto callbacks: {&preTickCallbacks, &postTickCallbacks}) {
+            for(auto it = callbacks->begin(); it != callbacks->end(); it++) {
+                if(it->first == id) {
+                    callbacks->erase(it);
+                    return;
+                }
+            }
+        }
+    }
+
+    //////////////////////////////////////////
+    // adds a body to the world with a collision category (COLLISION_AUTO: static world or prop depending on the mass)
+    // and a mask (COLLISION_GROUP_MASK: the default mask of the category)
+    void AddRigidBody(btRigidBody *body, int group = COLLISION_AUTO, int mask = COLLISION_GROUP_MASK) {
+        if(group == COLLISION_AUTO)
+            group = body->isStaticObject() ? COLLISION_STATIC : COLLISION_PROP;
+        if(mask == COLLISION_GROUP_MASK)
+            mask = collisionMask(group);
+        this->dynamicsWorld->addRigidBody(body, group, mask);
+    }
+
+    //////////////////////////////////////////
+    // adds a ghost object (a trigger volume) to the world: the broadphase keeps the list of the objects overlapping
+    // each ghost, updated only when the pairs are added or removed. The callback doing it is installed with the
+    // first ghost, so worlds without ghosts don't pay it for each pair
+    void AddGhostObject(btPairCachingGhostObject *ghost, int group = COLLISION_TRIGGER, int mask = COLLISION_GROUP_MASK) {
+        if(!this->ghostPairCallback) {
+            this->ghostPairCallback = new btGhostPairCallback();
+            this->dynamicsWorld->getPairCache()->setInternalGhostPairCallback(this->ghostPairCallback);
+        }
+        if(mask == COLLISION_GROUP_MASK)
+            mask = collisionMask(group);
+        // a trigger is crossed by the other objects
+        ghost->setCollisionFlags(ghost->getCollisionFlags() | btCollisionObject::CF_NO_CONTACT_RESPONSE);
+        this->dynamicsWorld->addCollisionObject(ghost, group, mask);
+    }
+
     //////////////////////////////////////////
     // We delete the data of the physical simulation when the program ends
     void Clear()
     {
+        // the world can be cleared explicitly before the destructor
+        if(!this->dynamicsWorld) return;
+
         //we remove the rigid bodies from the dynamics world and delete them
         for (int i=this->dynamicsWorld->getNumCollisionObjects()-1; i>=0 ;i--)
         {
@@ -265,40 +442,133 @@ public:
 
         //delete broadphase
         delete this->overlappingPairCache;
+        delete this->ghostPairCallback;
+        this->ghostPairCallback = nullptr;
 
         //delete dispatcher
         delete this->dispatcher;
 
         delete this->collisionConfiguration;
+        this->dynamicsWorld = nullptr;
 
+        // we delete the Collision Shapes, with the meshes of the triangle mesh shapes
+        for (int i = 0; i < this->collisionShapes.size(); i++)
+        {
+            btCollisionShape* shape = this->collisionShapes[i];
+            if (shape->getShapeType() == TRIANGLE_MESH_SHAPE_PROXYTYPE)
+            {
+                delete ((btBvhTriangleMeshShape*) shape)->getMeshInterface();
+            }
+            delete shape;
+        }
         this->collisionShapes.clear();
+        this->hullCache.clear();
     }
 
-private:
     //////////////////////////////////////////
-    // constructor
-    // we set all the classes needed for the physical simulation
-    Physics()
-    {
-        // Collision configuration, to be used by the collision detection class
-        // collision configuration contains default setup for memory, collision setup. Advanced users can create their own configuration.
-        this->collisionConfiguration = new btDefaultCollisionConfiguration();
+    // returns the simplified convex hull of the model, building it only the first time
+    // the model is requested with this scale
+    btConvexHullShape* getSimplifiedHull(Model *model, glm::vec3 scale) {
+        auto key = std::make_tuple(model, scale.x, scale.y, scale.z);
+        auto cached = hullCache.find(key);
+        if(cached != hullCache.end()) {
+            return cached->second;
+        }
+        PhysicsAllocator::Scope memoryScope(MEMORY_SHAPES);
 
-        // default collision dispatcher (= collision detection method). For parallel processing you can use a diffent dispatcher (see Extras/BulletMultiThreaded)
-        this->dispatcher = new btCollisionDispatcher(this->collisionConfiguration);
+        btConvexHullShape fullHull;
+        for(auto &mesh: model->meshes) {
+            for(auto &vertex: mesh.vertices) {
+                auto vertexPos = vertex.Position;
+                fullHull.addPoint(btVector3(vertexPos.x, vertexPos.y, vertexPos.z), false);
+            }
+        }
+        fullHull.recalcLocalAabb();
+
+        btConvexHullShape *hull;
+        if(fullHull.getNumPoints() <= MAX_HULL_POINTS) {
+            hull = new btConvexHullShape((const btScalar*) fullHull.getUnscaledPoints(), fullHull.getNumPoints());
+        } else {
+            // we reduce the point set to the support points of the hull in a fixed set of 42 directions
+            // so the simplified hull has always less than MAX_HULL_POINTS points
+            btShapeHull shapeHull(&fullHull);
+            shapeHull.buildHull(fullHull.getMargin());
+            hull = new btConvexHullShape((const btScalar*) shapeHull.getVertexPointer(), shapeHull.numVertices());
+        }
 
-        // btDbvtBroadphase is a good general purpose broadphase. You can also try out btAxis3Sweep.
-        this->overlappingPairCache = new btDbvtBroadphase();
+        hull->setLocalScaling(btVector3(scale.x, scale.y, scale.z));
+        this->collisionShapes.push_back(hull);
+        hullCache[key] = hull;
+        return hull;
+    }
 
-        // we set a ODE solver, which considers forces, constraints, collisions etc., to calculate positions and rotations of the rigid bodies.
-        // the default constraint solver. For parallel processing you can use a different solver (see Extras/BulletMultiThreaded)
-        this->solver = new btSequentialImpulseConstraintSolver();
+private:
+    std::vector<std::pair<int, TickCallback>> preTickCallbacks, postTickCallbacks;
+    int nextTickCallbackId = 0;
+    // keeps the overlapping objects of the ghosts, created with the first ghost
+    btGhostPairCallback *ghostPairCallback = nullptr;
+
+    static void preTick(btDynamicsWorld *world, btScalar timeStep) {
+        auto simulation = (Physics*) world->getWorldUserInfo();
+        for(auto &callback: simulation->preTickCallbacks) callback.second(timeStep);
+    }
 
-        //  DynamicsWorld is the main class for the physical simulation
-        this->dynamicsWorld = new btDiscreteDynamicsWorld(this->dispatcher,this->overlappingPairCache,this->solver,this->collisionConfiguration);
+    static void postTick(btDynamicsWorld *world, btScalar timeStep) {
+        auto simulation = (Physics*) world->getWorldUserInfo();
+        for(auto &callback: simulation->postTickCallbacks) callback.second(timeStep);
+    }
 
-        // we set the gravity force
-        this->dynamicsWorld->setGravity(btVector3(0.0f, -9.82f, 0.0f));
+    // simplified convex hulls already created for a model with a given scale
+    std::map<std::tuple<Model*, float, float, float>, btConvexHullShape*> hullCache;
+
+    // the collision mesh doesn't copy the geometry: it indexes directly the vertex and index
+    // buffers of the mesh, reading only the position of each Vertex (the first member of the struct)
+    // N.B.) so the mesh (and its model) must outlive the physics simulation
+    btIndexedMesh indexedMeshFromMesh(Mesh &mesh) {
+        btIndexedMesh indexedMesh;
+        indexedMesh.m_numTriangles = mesh.indices.size() / 3;
+        indexedMesh.m_triangleIndexBase = (const unsigned char*) &mesh.indices[0];
+        indexedMesh.m_triangleIndexStride = 3 * sizeof(GLuint);
+        indexedMesh.m_numVertices = mesh.vertices.size();
+        indexedMesh.m_vertexBase = (const unsigned char*) &mesh.vertices[0].Position;
+        indexedMesh.m_vertexStride = sizeof(Vertex);
+        indexedMesh.m_vertexType = PHY_FLOAT;
+        return indexedMesh;
+    }
+
+    btRigidBody* createStaticRigidBodyFromTriangleMesh(btStridingMeshInterface *triangleMesh, glm::vec3 pos, glm::vec3 rot, glm::vec3 scale, int group, int mask) {
+        auto cShape = new btBvhTriangleMeshShape(triangleMesh, true, true);
+        cShape->setLocalScaling(btVector3(scale.x, scale.y, scale.z));
+        this->collisionShapes.push_back(cShape);
+
+        // we set a quaternion from the Euler angles passed as parameters
+        btQuaternion rotation;
+        rotation.setEuler(rot.x, rot.y, rot.z);
+        btVector3 position(pos.x, pos.y, pos.z);
+
+        // We set the initial transformations
+        btTransform objTransform;
+        objTransform.setIdentity();
+        objTransform.setRotation(rotation);
+        // we set the initial position (it must be equal to the position of the corresponding model of the scene)
+        objTransform.setOrigin(position);
+
+        // if it is dynamic (mass > 0) then we calculates local inertia
+        btVector3 localInertia(0.0f, 0.0f, 0.0f);
+
+        PhysicsAllocator::Scope memoryScope(MEMORY_BODIES);
+        // we initialize the Motion State of the object on the basis of the transformations
+        // using the Motion State, the physical simulation will calculate the positions and rotations of the rigid body
+        RenderMotionState* motionState = new RenderMotionState(objTransform);
+        // we set the data structure for the rigid body, mass is always 0 for mesh object (bullet)
+        btRigidBody::btRigidBodyConstructionInfo rbInfo(0.f, motionState, cShape, localInertia);
+        // we create the rigid body
+        btRigidBody* body = new btRigidBody(rbInfo);
+
+        //add the body to the dynamics world, with its collision category
+        AddRigidBody(body, group, mask);
+
+        return body;
     }
 
 };
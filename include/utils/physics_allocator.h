@@ -0,0 +1,287 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+// categories of the memory allocated by Bullet, used only for the statistics
+enum PhysicsMemoryCategory {
+    MEMORY_SHAPES,
+    MEMORY_BODIES,
+    MEMORY_BROADPHASE,
+    MEMORY_MANIFOLDS,
+    MEMORY_SOLVER,
+    MEMORY_OTHER,
+    MEMORY_CATEGORY_COUNT,
+};
+
+const char *physicsMemoryCategoryNames[MEMORY_CATEGORY_COUNT] = {
+    "Shapes", "Bodies", "Broadphase", "Manifolds", "Solver", "Other",
+};
+
+// counters of a single category
+struct PhysicsMemoryCounters {
+    std::atomic<long long> LiveBytes{0};
+    std::atomic<long long> Allocations{0};
+    std::atomic<long long> Frees{0};
+};
+
+// sizes of the blocks of the pools, bigger allocations go directly to malloc
+const size_t physicsSizeClasses[] = {16, 32, 64, 128, 256, 512, 1024, 2048};
+constexpr int PHYSICS_SIZE_CLASS_COUNT = sizeof(physicsSizeClasses) / sizeof(physicsSizeClasses[0]);
+constexpr uint16_t PHYSICS_LARGE_BLOCK = 0xFFFF;
+// memory requested to the system each time a pool is empty
+constexpr size_t PHYSICS_POOL_CHUNK_SIZE = 64 * 1024;
+// blocks kept by each thread for each size class before giving them back to the shared pool
+constexpr int PHYSICS_THREAD_CACHE_SIZE = 64;
+
+// Allocator used by Bullet for all its memory (btAlignedAlloc, and so also all the new of the
+// Bullet classes: shapes, bodies, motion states, manifolds...).
+// Small blocks come from size-class pools, with a small per-thread cache so that worlds stepped
+// from different threads rarely contend for the same lock.
+// Each block has a 16 bytes header that keeps its size class and category, so the
+// memory of each category can be tracked when the block is freed.
+class PhysicsAllocator {
+public:
+    // installs the allocator in Bullet, it must be called before any Bullet allocation
+    static void Install() {
+        // the static initialization is thread safe, so worlds can be created from different threads
+        static bool installed = install();
+        (void) installed;
+    }
+
+private:
+    static bool install() {
+        // the state is never deallocated: Bullet can free memory also during the static destruction
+        state = new SharedState();
+        btAlignedAllocSetCustom(allocate, deallocate);
+        btAlignedAllocSetCustomAligned(allocateAligned, deallocate);
+
+        // Bullet marks its phases with profile zones, we use them to know who is allocating
+        previousEnterZone = btGetCurrentEnterProfileZoneFunc();
+        previousLeaveZone = btGetCurrentLeaveProfileZoneFunc();
+        btSetCustomEnterProfileZoneFunc(enterZone);
+        btSetCustomLeaveProfileZoneFunc(leaveZone);
+        return true;
+    }
+
+public:
+    static PhysicsMemoryCounters &Counters(PhysicsMemoryCategory category) {
+        return state->counters[category];
+    }
+
+    // allocations per second of the category, updated by UpdateRates
+    static float AllocationRate(PhysicsMemoryCategory category) {
+        return state->rates[category];
+    }
+
+    // to be called once per frame: every second the allocation rate of each category is updated
+    static void UpdateRates(float deltaTime) {
+        state->elapsedTime += deltaTime;
+        if(state->elapsedTime < 1.f) return;
+        for(int i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+            long long allocations = state->counters[i].Allocations;
+            state->rates[i] = (allocations - state->lastAllocations[i]) / state->elapsedTime;
+            state->lastAllocations[i] = allocations;
+        }
+        state->elapsedTime = 0.f;
+    }
+
+    // RAII guard that sets the category of the allocations done by the current thread
+    class Scope {
+    public:
+        Scope(PhysicsMemoryCategory category): previous(currentCategory) {
+            currentCategory = category;
+        }
+        ~Scope() {
+            currentCategory = previous;
+        }
+    private:
+        PhysicsMemoryCategory previous;
+    };
+
+private:
+    struct BlockHeader {
+        uint16_t sizeClass;
+        uint16_t category;
+        uint32_t size;
+        // start of the memory returned by malloc, only for large blocks
+        void *base;
+    };
+    static_assert(sizeof(BlockHeader) <= 16, "the header must keep the 16 bytes alignment of the blocks");
+
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    struct SizeClassPool {
+        std::mutex lock;
+        FreeBlock *freeList = nullptr;
+    };
+
+    struct SharedState {
+        SizeClassPool pools[PHYSICS_SIZE_CLASS_COUNT];
+        PhysicsMemoryCounters counters[MEMORY_CATEGORY_COUNT];
+        long long lastAllocations[MEMORY_CATEGORY_COUNT] = {};
+        float rates[MEMORY_CATEGORY_COUNT] = {};
+        float elapsedTime = 0.f;
+    };
+
+    // blocks freed by a thread, reused by the same thread without locking the shared pool
+    struct ThreadCache {
+        FreeBlock *freeList[PHYSICS_SIZE_CLASS_COUNT] = {};
+        int count[PHYSICS_SIZE_CLASS_COUNT] = {};
+
+        ~ThreadCache() {
+            // when the thread ends its blocks go back to the shared pools
+            for(int i = 0; i < PHYSICS_SIZE_CLASS_COUNT; i++) {
+                while(freeList[i]) {
+                    FreeBlock *block = freeList[i];
+                    freeList[i] = block->next;
+                    pushShared(i, block);
+                }
+            }
+        }
+    };
+
+    static int sizeClassOf(size_t size) {
+        for(int i = 0; i < PHYSICS_SIZE_CLASS_COUNT; i++) {
+            if(size <= physicsSizeClasses[i]) return i;
+        }
+        return -1;
+    }
+
+    static void pushShared(int sizeClass, FreeBlock *block) {
+        auto &pool = state->pools[sizeClass];
+        std::lock_guard<std::mutex> guard(pool.lock);
+        block->next = pool.freeList;
+        pool.freeList = block;
+    }
+
+    static FreeBlock *popShared(int sizeClass) {
+        auto &pool = state->pools[sizeClass];
+        std::lock_guard<std::mutex> guard(pool.lock);
+        if(!pool.freeList) {
+            // the pool is empty: we split a new chunk in blocks (header + payload)
+            size_t blockSize = physicsSizeClasses[sizeClass] + 16;
+            size_t blockCount = PHYSICS_POOL_CHUNK_SIZE / blockSize;
+            auto chunk = (unsigned char*) malloc(blockCount * blockSize);
+            if(!chunk) return nullptr;
+            for(size_t i = 0; i < blockCount; i++) {
+                auto block = (FreeBlock*) (chunk + i * blockSize);
+                block->next = pool.freeList;
+                pool.freeList = block;
+            }
+        }
+        FreeBlock *block = pool.freeList;
+        pool.freeList = block->next;
+        return block;
+    }
+
+    static void *allocateAligned(size_t size, int alignment) {
+        PhysicsMemoryCategory category = currentCategory;
+        int sizeClass = alignment <= 16 ? sizeClassOf(size) : -1;
+        BlockHeader *header;
+        if(sizeClass >= 0) {
+            auto &cache = threadCache;
+            FreeBlock *block = cache.freeList[sizeClass];
+            if(block) {
+                cache.freeList[sizeClass] = block->next;
+                cache.count[sizeClass]--;
+            } else {
+                block = popShared(sizeClass);
+                if(!block) return nullptr;
+            }
+            header = (BlockHeader*) block;
+            header->base = nullptr;
+        } else {
+            // large or over-aligned block: the header is placed just before the aligned memory
+            size_t blockAlignment = alignment > 16 ? alignment : 16;
+            auto base = (unsigned char*) malloc(size + blockAlignment + 16);
+            if(!base) return nullptr;
+            uintptr_t memory = ((uintptr_t) base + 16 + blockAlignment - 1) & ~(uintptr_t) (blockAlignment - 1);
+            header = (BlockHeader*) (memory - 16);
+            header->base = base;
+        }
+        header->sizeClass = sizeClass >= 0 ? sizeClass : PHYSICS_LARGE_BLOCK;
+        header->category = category;
+        header->size = (uint32_t) size;
+
+        auto &counters = state->counters[category];
+        counters.LiveBytes += size;
+        counters.Allocations++;
+        return (unsigned char*) header + 16;
+    }
+
+    static void *allocate(size_t size) {
+        return allocateAligned(size, 16);
+    }
+
+    static void deallocate(void *memory) {
+        if(!memory) return;
+        auto header = (BlockHeader*) ((unsigned char*) memory - 16);
+        auto &counters = state->counters[header->category];
+        counters.LiveBytes -= header->size;
+        counters.Frees++;
+
+        if(header->sizeClass == PHYSICS_LARGE_BLOCK) {
+            free(header->base);
+            return;
+        }
+        int sizeClass = header->sizeClass;
+        auto block = (FreeBlock*) header;
+        auto &cache = threadCache;
+        if(cache.count[sizeClass] < PHYSICS_THREAD_CACHE_SIZE) {
+            block->next = cache.freeList[sizeClass];
+            cache.freeList[sizeClass] = block;
+            cache.count[sizeClass]++;
+        } else {
+            pushShared(sizeClass, block);
+        }
+    }
+
+    // profile zones of Bullet that change the category of the allocations
+    static PhysicsMemoryCategory categoryOfZone(const char *name, PhysicsMemoryCategory current) {
+        if(strcmp(name, "calculateOverlappingPairs") == 0) return MEMORY_BROADPHASE;
+        if(strcmp(name, "dispatchAllCollisionPairs") == 0) return MEMORY_MANIFOLDS;
+        if(strcmp(name, "solveConstraints") == 0) return MEMORY_SOLVER;
+        return current;
+    }
+
+    static void enterZone(const char *name) {
+        if(zoneDepth < MAX_ZONE_DEPTH)
+            zoneCategories[zoneDepth] = currentCategory;
+        zoneDepth++;
+        currentCategory = categoryOfZone(name, currentCategory);
+        previousEnterZone(name);
+    }
+
+    static void leaveZone() {
+        previousLeaveZone();
+        zoneDepth--;
+        if(zoneDepth < MAX_ZONE_DEPTH)
+            currentCategory = zoneCategories[zoneDepth];
+    }
+
+    static constexpr int MAX_ZONE_DEPTH = 64;
+
+    static SharedState *state;
+    static thread_local ThreadCache threadCache;
+    static thread_local PhysicsMemoryCategory currentCategory;
+    static thread_local PhysicsMemoryCategory zoneCategories[MAX_ZONE_DEPTH];
+    static thread_local int zoneDepth;
+    static btEnterProfileZoneFunc *previousEnterZone;
+    static btLeaveProfileZoneFunc *previousLeaveZone;
+};
+
+PhysicsAllocator::SharedState *PhysicsAllocator::state = nullptr;
+thread_local PhysicsAllocator::ThreadCache PhysicsAllocator::threadCache;
+thread_local PhysicsMemoryCategory PhysicsAllocator::currentCategory = MEMORY_OTHER;
+thread_local PhysicsMemoryCategory PhysicsAllocator::zoneCategories[PhysicsAllocator::MAX_ZONE_DEPTH];
+thread_local int PhysicsAllocator::zoneDepth = 0;
+btEnterProfileZoneFunc *PhysicsAllocator::previousEnterZone = nullptr;
+btLeaveProfileZoneFunc *PhysicsAllocator::previousLeaveZone = nullptr;
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include "./physics.h"
+
+// Level of detail of the simulation: the dynamic bodies far from the player (and from the other vehicles) are
+// frozen (DISABLE_SIMULATION, they are not integrated, not solved and their AABBs are not updated), and simulated
+// again when one of them comes close. Between WakeRadius and FreezeRadius nothing changes (hysteresis), so a body at the border doesn't
+// switch state at every frame.
+// The cost of an update doesn't depend on all the bodies of the world:
+// - the bodies to wake are searched with the broadphase, in the box around each center with side 2 * WakeRadius
+// - the awake bodies far from the player are searched round-robin, checking at most Budget objects per update
+// Frozen bodies keep their velocity, they continue their motion when woken.
+// N.B.) all the dynamic bodies of the categories in Groups with DISABLE_SIMULATION are considered frozen by the LOD
+class PhysicsLod {
+public:
+    PhysicsLod(Physics &simulation, float wakeRadius = 60.f, float freezeRadius = 80.f): WakeRadius(wakeRadius),
+        FreezeRadius(freezeRadius), simulation(simulation) {}
+
+    // updates the state of the bodies around the player position
+    void Update(const btVector3 &center) {
+        singleCenter.resize(1);
+        singleCenter[0] = center;
+        Update(singleCenter);
+    }
+
+    // updates the state of the bodies around all the centers (e.g. the player and the AI vehicles)
+    void Update(const btAlignedObjectArray<btVector3> &centers) {
+        // wakes the frozen bodies inside WakeRadius
+        WakeCallback wake;
+        wake.lod = this;
+        btVector3 extent(WakeRadius, WakeRadius, WakeRadius);
+        for(int c = 0; c < centers.size(); c++) {
+            wake.center = centers[c];
+            simulation.dynamicsWorld->getBroadphase()->aabbTest(centers[c] - extent, centers[c] + extent, wake);
+        }
+
+        // freezes the awake bodies outside FreezeRadius of all the centers, a slice of the objects at each update
+        auto &objects = simulation.dynamicsWorld->getCollisionObjectArray();
+        int count = btMin(Budget, objects.size());
+        float freezeRadius2 = FreezeRadius * FreezeRadius;
+        for(int i = 0; i < count; i++) {
+            if(cursor >= objects.size()) cursor = 0;
+            btRigidBody *body = btRigidBody::upcast(objects[cursor++]);
+            if(!managed(body) || !body->isActive() || body->getActivationState() == DISABLE_DEACTIVATION) continue;
+            const btVector3 &origin = body->getWorldTransform().getOrigin();
+            bool far = true;
+            for(int c = 0; c < centers.size() && far; c++) {
+                far = origin.distance2(centers[c]) > freezeRadius2;
+            }
+            if(far) body->forceActivationState(DISABLE_SIMULATION);
+        }
+    }
+
+    // bodies closer than this radius are simulated
+    float WakeRadius;
+    // bodies farther than this radius are frozen
+    float FreezeRadius;
+    // objects checked for freezing at each update
+    int Budget = 256;
+    // categories of the bodies managed by the LOD
+    int Groups = COLLISION_PROP | COLLISION_PROJECTILE | COLLISION_DEBRIS;
+
+private:
+    struct WakeCallback : public btBroadphaseAabbCallback {
+        PhysicsLod *lod;
+        btVector3 center;
+
+        bool process(const btBroadphaseProxy *proxy) override {
+            btRigidBody *body = btRigidBody::upcast((btCollisionObject*) proxy->m_clientObject);
+            if(lod->managed(body) && body->getActivationState() == DISABLE_SIMULATION &&
+               body->getWorldTransform().getOrigin().distance2(center) < lod->WakeRadius * lod->WakeRadius) {
+                // setActivationState doesn't change DISABLE_SIMULATION, only forceActivationState does
+                body->forceActivationState(ACTIVE_TAG);
+                body->setDeactivationTime(0.f);
+            }
+            return true;
+        }
+    };
+
+    Physics &simulation;
+    int cursor = 0;
+    btAlignedObjectArray<btVector3> singleCenter;
+
+    bool managed(const btRigidBody *body) {
+        if(!body || body->isStaticOrKinematicObject()) return false;
+        auto proxy = body->getBroadphaseHandle();
+        return proxy && (proxy->m_collisionFilterGroup & Groups);
+    }
+};
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+// time spent in a Bullet profile zone during the last profiled step
+struct PhysicsZoneResult {
+    const char *Name;
+    // nesting level of the zone, 0 for stepSimulation
+    int Depth;
+    // milliseconds spent in the zone (and its children)
+    double Time;
+    // times the zone was entered (e.g. one for each substep)
+    int Calls;
+};
+
+// Profiler of the internal phases of Bullet (broadphase, narrowphase, solver, integration, actions...).
+// Bullet marks its phases with BT_PROFILE: we install our own enter/leave functions and build the
+// same tree of zones of the Bullet CProfileIterator, without the need of a Bullet build with
+// BT_ENABLE_PROFILE. The tree is kept per thread, so each thread stepping a world has its own results.
+// EndStep must be called after stepSimulation: it collects the times of the step and resets the tree.
+class PhysicsProfiler {
+public:
+    // installs the profile zone functions, the ones already installed (e.g. by the PhysicsAllocator)
+    // are still called
+    static void Install() {
+        // the static initialization is thread safe, so worlds can be created from different threads
+        static bool installed = install();
+        (void) installed;
+    }
+
+private:
+    static bool install() {
+        previousEnterZone = btGetCurrentEnterProfileZoneFunc();
+        previousLeaveZone = btGetCurrentLeaveProfileZoneFunc();
+        btSetCustomEnterProfileZoneFunc(enterZone);
+        btSetCustomLeaveProfileZoneFunc(leaveZone);
+        return true;
+    }
+
+public:
+    // walks the tree of the zones entered from the last call, saving their times in Results
+    // (children after their parent) and appending them to the trace file, if open
+    static void EndStep() {
+        auto &tree = threadTree;
+        tree.results.clear();
+        for(int child: tree.nodes[0].children) {
+            collect(tree, child, 0);
+        }
+        if(traceFile) {
+            // the trace is the only state shared by the threads
+            std::lock_guard<std::mutex> guard(traceLock);
+            for(auto &result: tree.results) {
+                fprintf(traceFile, "%d,%s,%d,%f,%d\n", tree.step, result.Name, result.Depth, result.Time, result.Calls);
+            }
+        }
+        tree.step++;
+    }
+
+    // results of the last step profiled by this thread
+    static const std::vector<PhysicsZoneResult> &Results() {
+        return threadTree.results;
+    }
+
+    // time of a zone in the last step, summing all the places of the tree where it appears
+    static double ZoneTime(const char *name) {
+        double time = 0.0;
+        for(auto &result: threadTree.results) {
+            if(strcmp(result.Name, name) == 0) time += result.Time;
+        }
+        return time;
+    }
+
+    // the times of each step are appended to a csv file (step, zone, depth, ms, calls)
+    static bool OpenTrace(const char *path) {
+        CloseTrace();
+        traceFile = fopen(path, "w");
+        if(!traceFile) {
+            printf("Unable to open the physics trace file %s\n", path);
+            return false;
+        }
+        fprintf(traceFile, "step,zone,depth,ms,calls\n");
+        return true;
+    }
+
+    static void CloseTrace() {
+        if(!traceFile) return;
+        fclose(traceFile);
+        traceFile = nullptr;
+    }
+
+    static bool IsTracing() {
+        return traceFile != nullptr;
+    }
+
+private:
+    typedef std::chrono::high_resolution_clock profilerClock;
+
+    struct Node {
+        const char *name;
+        int parent;
+        std::vector<int> children = {};
+        profilerClock::time_point start = {};
+        double time = 0.0;
+        int calls = 0;
+    };
+
+    struct Tree {
+        // the first node is the root, it is never entered
+        std::vector<Node> nodes = std::vector<Node>(1, Node{"root", -1});
+        int current = 0;
+        int step = 0;
+        std::vector<PhysicsZoneResult> results;
+    };
+
+    static void enterZone(const char *name) {
+        previousEnterZone(name);
+        auto &tree = threadTree;
+        // Bullet always uses string literals for the zones, so as CProfileNode we compare the pointers
+        int node = -1;
+        for(int child: tree.nodes[tree.current].children) {
+            if(tree.nodes[child].name == name) {
+                node = child;
+                break;
+            }
+        }
+        if(node < 0) {
+            node = tree.nodes.size();
+            tree.nodes.push_back(Node{name, tree.current});
+            tree.nodes[tree.current].children.push_back(node);
+        }
+        tree.current = node;
+        tree.nodes[node].calls++;
+        tree.nodes[node].start = profilerClock::now();
+    }
+
+    static void leaveZone() {
+        auto &tree = threadTree;
+        if(tree.current > 0) {
+            auto &node = tree.nodes[tree.current];
+            std::chrono::duration<double, std::milli> elapsed = profilerClock::now() - node.start;
+            node.time += elapsed.count();
+            tree.current = node.parent;
+        }
+        previousLeaveZone();
+    }
+
+    static void collect(Tree &tree, int index, int depth) {
+        auto &node = tree.nodes[index];
+        // the nodes are kept between the steps, zones not entered in this step are skipped
+        if(node.calls > 0) {
+            tree.results.push_back(PhysicsZoneResult{node.name, depth, node.time, node.calls});
+        }
+        node.time = 0.0;
+        node.calls = 0;
+        for(int child: node.children) {
+            collect(tree, child, depth + 1);
+        }
+    }
+
+    static thread_local Tree threadTree;
+    static FILE *traceFile;
+    static std::mutex traceLock;
+    static btEnterProfileZoneFunc *previousEnterZone;
+    static btLeaveProfileZoneFunc *previousLeaveZone;
+};
+
+thread_local PhysicsProfiler::Tree PhysicsProfiler::threadTree;
+FILE *PhysicsProfiler::traceFile = nullptr;
+std::mutex PhysicsProfiler::traceLock;
+btEnterProfileZoneFunc *PhysicsProfiler::previousEnterZone = nullptr;
+btLeaveProfileZoneFunc *PhysicsProfiler::previousLeaveZone = nullptr;
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <vector>
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include "./physics.h"
+
+// Fixed-size pool of the spheres shot by the vehicle.
+// All the projectiles share the same collision shape and the rigid bodies are allocated only once:
+// a projectile is added to the world when shot and removed when it is too old or too far from the
+// vehicle, so the number of bodies in the world (and the memory used) never grows during the game.
+// A pool of size 0 (e.g. of the AI vehicles, that never shoot) allocates nothing and doesn't spawn.
+class ProjectilePool {
+public:
+    ProjectilePool(Physics &simulation, int size, float radius, float mass, float friction, float restitution): simulation(simulation) {
+        if(size <= 0) return;
+        shape = new btSphereShape(radius);
+        simulation.collisionShapes.push_back(shape);
+
+        btVector3 localInertia(0.0f, 0.0f, 0.0f);
+        shape->calculateLocalInertia(mass, localInertia);
+
+        projectiles.resize(size);
+        for(auto &projectile: projectiles) {
+            RenderMotionState* motionState = new RenderMotionState(btTransform::getIdentity());
+            btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, motionState, shape, localInertia);
+            rbInfo.m_friction = friction;
+            rbInfo.m_restitution = restitution;
+            rbInfo.m_linearSleepingThreshold = simulation.Config.LinearSleepingThreshold;
+            rbInfo.m_angularSleepingThreshold = simulation.Config.AngularSleepingThreshold;
+            // same as the spheres created by the Physics class: rolling friction and angular damping
+            // are needed to stop a sphere rolling on a plane
+            rbInfo.m_angularDamping = 0.3f;
+            rbInfo.m_rollingFriction = 0.3f;
+            projectile.body = new btRigidBody(rbInfo);
+        }
+    }
+
+    ProjectilePool(const ProjectilePool& copy) = delete; //disallow copy
+    ProjectilePool& operator=(const ProjectilePool &) = delete;
+
+    ~ProjectilePool() {
+        // bodies in the world are deallocated by the world (see Physics::Clear),
+        // only the ones kept out of the world are deleted here
+        for(auto &projectile: projectiles) {
+            if(projectile.active) continue;
+            delete projectile.body->getMotionState();
+            delete projectile.body;
+        }
+    }
+
+    // adds a projectile to the world at the given position, if all the projectiles are
+    // already in the world the oldest one is recycled (nullptr if the pool is empty)
+    btRigidBody *Spawn(const btVector3 &position) {
+        if(projectiles.empty()) return nullptr;
+        Projectile *spawned = nullptr;
+        for(auto &projectile: projectiles) {
+            if(!projectile.active) {
+                spawned = &projectile;
+                break;
+            }
+            if(!spawned || projectile.age > spawned->age) {
+                spawned = &projectile;
+            }
+        }
+        if(spawned->active) {
+            despawn(*spawned);
+        }
+
+        btTransform transform;
+        transform.setIdentity();
+        transform.setOrigin(position);
+        btRigidBody *body = spawned->body;
+        body->setWorldTransform(transform);
+        body->getMotionState()->setWorldTransform(transform);
+        body->setInterpolationWorldTransform(transform);
+        body->setLinearVelocity(btVector3(0, 0, 0));
+        body->setAngularVelocity(btVector3(0, 0, 0));
+        body->clearForces();
+
+        simulation.AddRigidBody(body, COLLISION_PROJECTILE);
+        // also a projectile left frozen by the physics LOD is simulated again
+        body->forceActivationState(ACTIVE_TAG);
+        body->activate(true);
+        spawned->active = true;
+        spawned->age = 0.f;
+        activeCount++;
+        return body;
+    }
+
+    // removes from the world the projectiles older than Lifetime or farther than MaxDistance from center
+    void Update(float deltaTime, const btVector3 &center) {
+        float maxDistance2 = MaxDistance * MaxDistance;
+        for(auto &projectile: projectiles) {
+            if(!projectile.active) continue;
+            projectile.age += deltaTime;
+            auto distance2 = projectile.body->getWorldTransform().getOrigin().distance2(center);
+            if(projectile.age > Lifetime || distance2 > maxDistance2) {
+                despawn(projectile);
+            }
+        }
+    }
+
+    // state of the pool saved by a snapshot: the age of each projectile, negative if it is not in the world
+    void SaveState(std::vector<float> &ages) {
+        ages.resize(projectiles.size());
+        for(int i = 0; i < projectiles.size(); i++) {
+            ages[i] = projectiles[i].active ? projectiles[i].age : -1.f;
+        }
+    }
+
+    // adds and removes the projectiles to have in the world the same ones of the saved state,
+    // their transform and velocity are restored with all the other bodies by the snapshot
+    void RestoreState(const std::vector<float> &ages) {
+        for(int i = 0; i < projectiles.size(); i++) {
+            auto &projectile = projectiles[i];
+            bool active = ages[i] >= 0.f;
+            if(projectile.active && !active) {
+                despawn(projectile);
+            } else if(!projectile.active && active) {
+                simulation.AddRigidBody(projectile.body, COLLISION_PROJECTILE);
+                projectile.active = true;
+                activeCount++;
+            }
+            projectile.age = active ? ages[i] : 0.f;
+        }
+    }
+
+    int ActiveCount() {
+        return activeCount;
+    }
+
+    int Size() {
+        return projectiles.size();
+    }
+
+    // seconds before a projectile is removed from the world
+    float Lifetime = 10.f;
+    // maximum distance from the vehicle before a projectile is removed from the world
+    float MaxDistance = 150.f;
+
+private:
+    struct Projectile {
+        btRigidBody *body = nullptr;
+        // seconds from the spawn
+        float age = 0.f;
+        // if the projectile is in the world
+        bool active = false;
+    };
+
+    void despawn(Projectile &projectile) {
+        simulation.dynamicsWorld->removeRigidBody(projectile.body);
+        projectile.active = false;
+        activeCount--;
+    }
+
+    Physics &simulation;
+    btSphereShape *shape = nullptr;
+    std::vector<Projectile> projectiles;
+    int activeCount = 0;
+};
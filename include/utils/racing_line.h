@@ -0,0 +1,160 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+// Closed racing line through a list of control points: a Catmull-Rom spline sampled in straight segments.
+// The segments are indexed by a uniform grid on the ground plane (x, z): each cell lists the segments crossing
+// it, so the closest point of the line is searched only in the cells around the position, ring after ring,
+// and the search stops when the next ring can't be closer. The cost doesn't depend on the length of the line.
+// The line is only read after it's built, so many drivers can query it at the same time from different threads.
+class RacingLine {
+public:
+    RacingLine(const std::vector<glm::vec3> &controlPoints, int samplesPerSpan = 8, float cellSize = 10.f): cellSize(cellSize) {
+        int spans = controlPoints.size();
+        for(int i = 0; i < spans; i++) {
+            const glm::vec3 &p0 = controlPoints[(i + spans - 1) % spans], &p1 = controlPoints[i];
+            const glm::vec3 &p2 = controlPoints[(i + 1) % spans], &p3 = controlPoints[(i + 2) % spans];
+            for(int s = 0; s < samplesPerSpan; s++) {
+                float t = (float) s / samplesPerSpan, t2 = t * t, t3 = t2 * t;
+                points.push_back(.5f * (2.f * p1 + (p2 - p0) * t + (2.f * p0 - 5.f * p1 + 4.f * p2 - p3) * t2 + (3.f * p1 - p0 - 3.f * p2 + p3) * t3));
+            }
+        }
+        // distances[i] is the distance along the line of points[i], the last segment closes the loop
+        distances.resize(points.size() + 1, 0.f);
+        for(int i = 0; i < points.size(); i++) {
+            distances[i + 1] = distances[i] + glm::length(next(i) - points[i]);
+        }
+        buildGrid();
+    }
+
+    float Length() const {
+        return distances.back();
+    }
+
+    int SegmentCount() const {
+        return points.size();
+    }
+
+    // distance along the line of the point closest to position (optionally returned in closest)
+    float ClosestDistance(const glm::vec3 &position, glm::vec3 *closest = nullptr) const {
+        int cellX = std::min(std::max((int) std::floor((position.x - minX) / cellSize), 0), cellsX - 1);
+        int cellZ = std::min(std::max((int) std::floor((position.z - minZ) / cellSize), 0), cellsZ - 1);
+        float bestDistance2 = INFINITY, bestDistance = 0.f;
+        glm::vec3 bestPoint(0.f);
+        int maxRing = std::max(cellsX, cellsZ);
+        for(int ring = 0; ring <= maxRing; ring++) {
+            // the cells of the ring are all the cells at ring steps from the cell of the position
+            for(int z = cellZ - ring; z <= cellZ + ring; z++) {
+                if(z < 0 || z >= cellsZ) continue;
+                bool border = z == cellZ - ring || z == cellZ + ring;
+                for(int x = cellX - ring; x <= cellX + ring; x += border ? 1 : 2 * std::max(ring, 1)) {
+                    if(x < 0 || x >= cellsX) continue;
+                    int cell = z * cellsX + x;
+                    for(int k = cellStarts[cell]; k < cellStarts[cell + 1]; k++) {
+                        int segment = cellSegments[k];
+                        glm::vec3 a = points[segment], ab = next(segment) - a;
+                        float length2 = glm::dot(ab, ab);
+                        float t = length2 > 0.f ? glm::clamp(glm::dot(position - a, ab) / length2, 0.f, 1.f) : 0.f;
+                        glm::vec3 point = a + ab * t;
+                        float distance2 = glm::dot(position - point, position - point);
+                        if(distance2 < bestDistance2) {
+                            bestDistance2 = distance2;
+                            bestPoint = point;
+                            bestDistance = distances[segment] + t * (distances[segment + 1] - distances[segment]);
+                        }
+                    }
+                }
+            }
+            // the cells of the next rings are at least ring cells away
+            float ringDistance = ring * cellSize;
+            if(bestDistance2 <= ringDistance * ringDistance) break;
+        }
+        if(closest) *closest = bestPoint;
+        return bestDistance;
+    }
+
+    // point of the line at a distance along it, wrapped around the loop
+    glm::vec3 PointAt(float distance) const {
+        float t;
+        int segment = segmentAt(distance, t);
+        return glm::mix(points[segment], next(segment), t);
+    }
+
+    // direction of the line at a distance along it
+    glm::vec3 DirectionAt(float distance) const {
+        float t;
+        int segment = segmentAt(distance, t);
+        glm::vec3 direction = next(segment) - points[segment];
+        float length = glm::length(direction);
+        return length > 0.f ? direction / length : glm::vec3(0.f, 0.f, 1.f);
+    }
+
+private:
+    std::vector<glm::vec3> points;
+    std::vector<float> distances;
+    // grid of the segments: the segments of cell c are cellSegments[cellStarts[c]] to cellSegments[cellStarts[c + 1] - 1]
+    float cellSize;
+    float minX = 0.f, minZ = 0.f;
+    int cellsX = 1, cellsZ = 1;
+    std::vector<int> cellStarts;
+    std::vector<int> cellSegments;
+
+    const glm::vec3 &next(int segment) const {
+        return points[(segment + 1) % points.size()];
+    }
+
+    int segmentAt(float distance, float &t) const {
+        float length = Length();
+        distance = std::fmod(distance, length);
+        if(distance < 0.f) distance += length;
+        int segment = std::upper_bound(distances.begin(), distances.end(), distance) - distances.begin() - 1;
+        segment = std::min(std::max(segment, 0), (int) points.size() - 1);
+        float segmentLength = distances[segment + 1] - distances[segment];
+        t = segmentLength > 0.f ? (distance - distances[segment]) / segmentLength : 0.f;
+        return segment;
+    }
+
+    // calls add(cell) for the cells overlapped by the bounds of a segment
+    template <typename AddFunction>
+    void forEachCell(int segment, AddFunction add) {
+        glm::vec3 a = points[segment], b = next(segment);
+        int x0 = (int) std::floor((std::min(a.x, b.x) - minX) / cellSize), x1 = (int) std::floor((std::max(a.x, b.x) - minX) / cellSize);
+        int z0 = (int) std::floor((std::min(a.z, b.z) - minZ) / cellSize), z1 = (int) std::floor((std::max(a.z, b.z) - minZ) / cellSize);
+        for(int z = std::max(z0, 0); z <= std::min(z1, cellsZ - 1); z++) {
+            for(int x = std::max(x0, 0); x <= std::min(x1, cellsX - 1); x++) {
+                add(z * cellsX + x);
+            }
+        }
+    }
+
+    void buildGrid() {
+        float maxX = -INFINITY, maxZ = -INFINITY;
+        minX = minZ = INFINITY;
+        for(auto &point: points) {
+            minX = std::min(minX, point.x);
+            minZ = std::min(minZ, point.z);
+            maxX = std::max(maxX, point.x);
+            maxZ = std::max(maxZ, point.z);
+        }
+        cellsX = (int) std::floor((maxX - minX) / cellSize) + 1;
+        cellsZ = (int) std::floor((maxZ - minZ) / cellSize) + 1;
+
+        // counting pass, then the segments are written in the slots of their cells
+        cellStarts.assign(cellsX * cellsZ + 1, 0);
+        for(int s = 0; s < points.size(); s++) {
+            forEachCell(s, [&](int cell) { cellStarts[cell + 1]++; });
+        }
+        for(int c = 0; c < cellsX * cellsZ; c++) {
+            cellStarts[c + 1] += cellStarts[c];
+        }
+        cellSegments.resize(cellStarts.back());
+        std::vector<int> fill(cellStarts.begin(), cellStarts.end() - 1);
+        for(int s = 0; s < points.size(); s++) {
+            forEachCell(s, [&](int cell) { cellSegments[fill[cell]++] = s; });
+        }
+    }
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Motion state of the bodies of the game: besides the transform it keeps the matrices used to draw the body.
+// Bullet calls setWorldTransform only for the bodies that moved in the step (sleeping and static bodies are
+// never synchronized), so the matrices are rebuilt only for them: the cost of the draw calls of a frame
+// grows with the moving bodies and not with all the bodies of the scene.
+class RenderMotionState : public btDefaultMotionState {
+public:
+    RenderMotionState(const btTransform &startTransform): btDefaultMotionState(startTransform) {}
+
+    void setWorldTransform(const btTransform &centerOfMassWorldTrans) override {
+        btDefaultMotionState::setWorldTransform(centerOfMassWorldTrans);
+        changed = true;
+    }
+
+    // model matrix of the body, with the scale of the model used to draw it
+    const glm::mat4 &ModelMatrix(const glm::vec3 &scale) {
+        update(scale);
+        return modelMatrix;
+    }
+
+    // inverse transpose of the model matrix, the normal matrix in view space is the rotation of the view
+    // (rigid) multiplied by this one
+    const glm::mat3 &ModelNormalMatrix(const glm::vec3 &scale) {
+        update(scale);
+        return modelNormalMatrix;
+    }
+
+private:
+    bool changed = true;
+    glm::vec3 modelScale;
+    glm::mat4 modelMatrix;
+    glm::mat3 modelNormalMatrix;
+
+    void update(const glm::vec3 &scale) {
+        if(!changed && scale == modelScale) return;
+        btTransform transform;
+        getWorldTransform(transform);
+        float matrix[16];
+        transform.getOpenGLMatrix(matrix);
+        modelMatrix = glm::make_mat4(matrix) * glm::scale(glm::mat4(1.0f), scale);
+        modelNormalMatrix = glm::inverseTranspose(glm::mat3(modelMatrix));
+        modelScale = scale;
+        changed = false;
+    }
+};
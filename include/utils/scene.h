@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include "./model.h"
+#include "./physics.h"
+#include "./vehicle.h"
+#include "./obstacle.h"
+
+// models used by the physical objects of the scene, loaded (and deallocated) by the application
+// the headless simulation loads them only on the CPU side
+struct SceneModels {
+    Model *bridge;
+    Model *ramp;
+    Model *raceTrack;
+    Model *bowlingPin;
+};
+
+// cubes created by the game, a grid of 5x5
+constexpr int DEFAULT_SCENE_CUBES = 25;
+
+// half size of the plane of the scene, everything happens on it
+const glm::vec3 SCENE_PLANE_SIZE(400.0f, 0.1f, 400.0f);
+
+// configuration of a world for the scene: the bounds for the axis sweep broadphase are the plane,
+// up to the height reached by the projectiles, and there is a handle for each object
+PhysicsConfig raceSceneConfig(BroadphaseType broadphase = BROADPHASE_DBVT, int cubeCount = DEFAULT_SCENE_CUBES) {
+    PhysicsConfig config;
+    config.Broadphase = broadphase;
+    config.WorldMin = btVector3(-SCENE_PLANE_SIZE.x, -50.f, -SCENE_PLANE_SIZE.z);
+    config.WorldMax = btVector3(SCENE_PLANE_SIZE.x, 200.f, SCENE_PLANE_SIZE.z);
+    // cubes, pins, projectiles, obstacles and some room for the objects added by the game
+    config.MaxHandles = cubeCount + 1024;
+    return config;
+}
+
+// Physical world of the game: plane, obstacles, bowling scene, vehicle and the grid of cubes.
+// The scene creates only the rigid bodies, so the same world can be built by the game and by the
+// headless simulation used for the load tests (where the number of cubes can be increased).
+class RaceScene {
+public:
+    RaceScene(Physics &bulletSimulation, const SceneModels &models, int cubeCount = DEFAULT_SCENE_CUBES):
+        Plane(bulletSimulation.createRigidBody(BOX, PlanePosition, PlaneSize, glm::vec3(0.f, 0.f, 0.f), 0.0f, 0.3f, 0.3f)),
+        Bridge(bulletSimulation, models.bridge, glm::vec3(0.f, -1.f, 10.f)),
+        RaceTrack(bulletSimulation, models.raceTrack, glm::vec3(50.f, -2.3f, 20.f), glm::vec3(.7f, .7f, .7f)),
+        Ramp(bulletSimulation, models.ramp, glm::vec3(60.f, -1.f, -50.f), glm::vec3(10.f, 10.f, 10.f)),
+        Car(bulletSimulation, glm::vec3(1.f, .5f, 2.f), WheelInfo()) {
+        glm::vec3 rot(0.f, 0.f, 0.f);
+
+        /// bowling scene: the ball in front of a rack of 10 pins
+        Ball = bulletSimulation.createRigidBody(SPHERE, glm::vec3(TrianglePinPosition.x, 1.f, TrianglePinPosition.z - 20.f), glm::vec3(3.f, 3.f, 3.f), rot, 15.f, .3f, 3.f);
+        std::vector<glm::vec3> pinOffsets {
+            glm::vec3(0.f, 0.f, 0.f),
+            glm::vec3(-1.f, 0.f, 1.f),
+            glm::vec3(1.f, 0.f, 1.f),
+            glm::vec3(-2.f, 0.f, 2.f),
+            glm::vec3(0.f, 0.f, 2.f),
+            glm::vec3(2.f, 0.f, 2.f),
+            glm::vec3(-3.f, 0.f, 3.f),
+            glm::vec3(-1.f, 0.f, 3.f),
+            glm::vec3(1.f, 0.f, 3.f),
+            glm::vec3(3.f, 0.f, 3.f),
+        };
+        for(auto &offset: pinOffsets) {
+            auto pinPos = TrianglePinPosition + offset * glm::vec3(1.5f, 1.f, 2.f);
+            // creating a rigid body from the convex hull of the model, shared by all the pins
+            auto pin = bulletSimulation.createConvexDynamicRigidBodyFromModel(models.bowlingPin, pinPos, rot, PinDimension, .2f, .3f, .3f);
+            Pins.push_back(pin);
+        }
+
+        /// grid of cubes, in the game 5x5 with 5 meters between each cube
+        // with more cubes the grid becomes denser to stay on the plane
+        int numSide = (int) ceil(sqrt((float) cubeCount));
+        float spacing = fmin(5.f, 390.f / numSide);
+        // we set a small initial rotation for the cubes
+        glm::vec3 cubeRot = glm::vec3(0.1f, 0.0f, 0.1f);
+        CubesStart = bulletSimulation.dynamicsWorld->getCollisionObjectArray().size();
+        for(int i = 0; i < cubeCount; i++) {
+            // position of each cube in the grid (we add 3 to x to have a bigger displacement)
+            auto cubePos = glm::vec3(3.0f + spacing * (i / numSide), 1.0f, spacing * (i % numSide));
+            // we create a rigid body (in this case, a dynamic body, with mass = 2)
+            bulletSimulation.createRigidBody(BOX, cubePos, CubeSize, cubeRot, 2.0f, 0.3f, 0.3f);
+        }
+
+        // static box used as a ramp
+        bulletSimulation.createRigidBody(BOX, glm::vec3(-50.f, -2.f, 0.f), glm::vec3(3.f), glm::vec3(0.f, 0.f, glm::radians(60.f)), 0, 0.3f, 0.3f);
+    }
+
+    RaceScene(const RaceScene& copy) = delete; //disallow copy
+    RaceScene& operator=(const RaceScene &) = delete;
+
+    // dimensions and position of the static plane
+    // we use a box to simulate the plane, because we need some "height" for the physics simulation
+    glm::vec3 PlanePosition = glm::vec3(0.0f, -1.0f, 0.0f);
+    glm::vec3 PlaneSize = SCENE_PLANE_SIZE;
+    btRigidBody *Plane;
+
+    Obstacle Bridge;
+    Obstacle RaceTrack;
+    Obstacle Ramp;
+
+    Vehicle Car;
+
+    glm::vec3 TrianglePinPosition = glm::vec3(-50.f, 1.f, -50.f);
+    glm::vec3 PinDimension = glm::vec3(10.f, 10.f, 10.f);
+    btRigidBody *Ball;
+    std::vector<btRigidBody*> Pins;
+
+    glm::vec3 CubeSize = glm::vec3(.4f, 1.f, .4f);
+    // index of the first cube in the collision objects of the world, all the following boxes and spheres
+    // (cubes, the static ramp and the projectiles) are drawn by the game looping on the world objects
+    int CubesStart;
+};
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+
+#include <glad/glad.h>
+
+#include <bullet/btBulletDynamicsCommon.h>
+#include <bullet/BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h>
+
+#include "./model.h"
+#include "./physics.h"
+#include "./depth_texture.h"
+#include "./heightmap_renderer.h"
+
+// number of pixel buffer objects used to read back the snow depth, while the GPU fills one
+// the others can be still in flight or ready to be read by the CPU
+constexpr int SNOW_READBACK_BUFFERS = 3;
+// minimum height of the snow, the same bias used in the tessellation shader (heightmap.tes)
+constexpr float SNOW_BIAS = 0.11f;
+
+// Physical surface of the snow: the depth texture of the heightmap is read back from the GPU
+// every few frames and copied in the height samples of a Bullet heightfield, so the vehicle
+// (and all the other objects) touch the deformed snow instead of the flat plane.
+// The readback is asynchronous: the depth is copied in a pixel buffer object and the CPU reads
+// it only when the GPU signals the copy is finished, so the render thread never waits the GPU.
+class SnowCollider {
+public:
+    SnowCollider(Physics &bulletSimulation, Heightmap &heightmap, GLuint heightmapFBO, int heightmapSize, int resolution=128, int readbackInterval=10):
+        ReadbackInterval(readbackInterval), heightmap(heightmap), sourceFBO(heightmapFBO),
+        sourceSize(heightmapSize), resolution(resolution), downsampledDepth(resolution, resolution) {
+        // the depth buffer of the heightmap is downsampled on the GPU before the readback,
+        // the texture is a DepthTexture as the heightmap one, so the blit is between the same depth format
+        glGenFramebuffers(1, &downsampleFBO);
+        downsampledDepth.AttachToFrameBuffer(downsampleFBO);
+
+        glGenBuffers(SNOW_READBACK_BUFFERS, pixelBuffers);
+        for(int i = 0; i < SNOW_READBACK_BUFFERS; i++) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, resolution * resolution * sizeof(GLfloat), NULL, GL_STREAM_READ);
+            fences[i] = 0;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        // at the beginning the snow is untouched (the depth texture is cleared to 1)
+        minHeight = heightmap.y + SNOW_BIAS * heightmap.depth;
+        maxHeight = heightmap.y + heightmap.depth;
+        heights.assign(resolution * resolution, maxHeight);
+
+        // Bullet doesn't copy the samples, so we can update them in place after each readback
+        auto shape = new btHeightfieldTerrainShape(resolution, resolution, &heights[0], minHeight, maxHeight, 1, false);
+        shape->setLocalScaling(btVector3(heightmap.width / (resolution - 1), 1.f, heightmap.height / (resolution - 1)));
+        bulletSimulation.collisionShapes.push_back(shape);
+
+        // the heightfield is centered in the middle of its height range
+        btTransform transform;
+        transform.setIdentity();
+        transform.setOrigin(btVector3(0.f, (minHeight + maxHeight) / 2.f, 0.f));
+        Body = bulletSimulation.localCreateRigidBody(0.f, transform, shape);
+        Body->setFriction(.3f);
+    }
+
+    SnowCollider(const SnowCollider& copy) = delete; //disallow copy
+    SnowCollider& operator=(const SnowCollider &) = delete;
+
+    // to be called once per frame after the heightmap depth buffer has been rendered
+    void Update() {
+        auto start = std::chrono::high_resolution_clock::now();
+        frame++;
+
+        // we apply the readbacks already finished by the GPU in the same order they were issued
+        for(int i = 0; i < SNOW_READBACK_BUFFERS && !Deterministic; i++) {
+            int slot = (nextBuffer + i) % SNOW_READBACK_BUFFERS;
+            if(!fences[slot]) continue;
+            // zero timeout: we only ask if the copy is finished, without waiting it
+            GLenum status = glClientWaitSync(fences[slot], 0, 0);
+            if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) continue;
+            readHeights(slot);
+            LatencyFrames = frame - issuedFrame[slot];
+        }
+
+        // a new readback only each few frames and only if there is a free buffer
+        if(frame % ReadbackInterval == 0) {
+            if(fences[nextBuffer] && Deterministic) {
+                // the oldest readback is applied before reusing its buffer, waiting the GPU if needed
+                glClientWaitSync(fences[nextBuffer], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+                readHeights(nextBuffer);
+                LatencyFrames = frame - issuedFrame[nextBuffer];
+            }
+            if(fences[nextBuffer]) {
+                SkippedReadbacks++;
+            } else {
+                issueReadback(nextBuffer);
+                nextBuffer = (nextBuffer + 1) % SNOW_READBACK_BUFFERS;
+            }
+        }
+
+        std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        UpdateTime = elapsed.count();
+    }
+
+    void Delete() {
+        for(int i = 0; i < SNOW_READBACK_BUFFERS; i++) {
+            if(fences[i]) glDeleteSync(fences[i]);
+        }
+        glDeleteBuffers(SNOW_READBACK_BUFFERS, pixelBuffers);
+        glDeleteFramebuffers(1, &downsampleFBO);
+    }
+
+    btRigidBody *Body;
+    // number of frames between two readbacks
+    int ReadbackInterval;
+    // when true each readback is applied always after the same number of frames, also if the
+    // GPU finished it before, so the simulation doesn't depend on the timing of the GPU (used by the replays)
+    bool Deterministic = false;
+
+    // cost of the readback reported for profiling
+    // CPU time spent in the last update (ms)
+    float UpdateTime = 0.f;
+    // frames between the request of the last completed readback and its use
+    int LatencyFrames = 0;
+    int CompletedReadbacks = 0;
+    // readbacks not issued because all the buffers were still in flight
+    int SkippedReadbacks = 0;
+
+private:
+    void issueReadback(int slot) {
+        // downsample the heightmap depth buffer
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, sourceFBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, downsampleFBO);
+        glBlitFramebuffer(0, 0, sourceSize, sourceSize, 0, 0, resolution, resolution, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        // copy it in the pixel buffer: with a buffer bound to GL_PIXEL_PACK_BUFFER glReadPixels returns immediately
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, downsampleFBO);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[slot]);
+        glReadPixels(0, 0, resolution, resolution, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        issuedFrame[slot] = frame;
+    }
+
+    void readHeights(int slot) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[slot]);
+        auto depth = (const GLfloat*) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, resolution * resolution * sizeof(GLfloat), GL_MAP_READ_BIT);
+        if(depth) {
+            // rows of the texture are along the z axis, as the rows of the heightfield
+            // the height is calculated as in the tessellation shader (without the noise)
+            for(int i = 0; i < resolution * resolution; i++) {
+                heights[i] = btMax(SNOW_BIAS, depth[i]) * heightmap.depth + heightmap.y;
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            CompletedReadbacks++;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        glDeleteSync(fences[slot]);
+        fences[slot] = 0;
+    }
+
+    Heightmap &heightmap;
+    GLuint sourceFBO;
+    int sourceSize;
+    // number of samples per side of the heightfield
+    int resolution;
+    float minHeight, maxHeight;
+    std::vector<float> heights;
+
+    DepthTexture downsampledDepth;
+    GLuint downsampleFBO;
+    GLuint pixelBuffers[SNOW_READBACK_BUFFERS];
+    GLsync fences[SNOW_READBACK_BUFFERS];
+    int issuedFrame[SNOW_READBACK_BUFFERS];
+    int nextBuffer = 0;
+    int frame = 0;
+};
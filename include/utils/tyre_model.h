@@ -0,0 +1,423 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include "./physics.h"
+#include "./vehicle.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    // SSE2 is always available on x64, the tyres are evaluated 4 wheels at a time
+    #define TYRE_MODEL_SSE
+    #include <emmintrin.h>
+#endif
+
+// Tyre forces of a batch of wheels with a simplified Pacejka magic formula:
+//   F = load * D * sin(C * atan(B * slip - E * (B * slip - atan(B * slip))))
+// for the longitudinal slip (ratio between the speed of the tread and of the ground) and the lateral slip (angle).
+// The wheels are kept as structure of arrays: each input and output is a contiguous array of floats.
+// Evaluate computes 4 wheels with each SSE instruction: atan and sin are polynomial approximations (errors around
+// 1e-5), since the functions of the standard library are scalar. The intrinsics are packed instructions also in
+// the builds without optimizations. EvaluateScalar is the same model with the standard functions, one wheel at a
+// time: the reference of the benchmark (and the path of the builds without SSE2).
+// Both also integrate the spin of the wheels: the drive torque against the longitudinal force and the brake.
+struct TyreBatch {
+    // inputs: speed of the ground under the wheel along the wheel direction and the axle (m/s), normal load (N)
+    std::vector<float> forwardSpeed, lateralSpeed, load;
+    // drive force at the contact (N, engine torque / radius) and brake force (N)
+    std::vector<float> drive, brake;
+    // wheel radius (m) and inertia (kg*m^2)
+    std::vector<float> radius, inertia;
+    // coefficients of the longitudinal and lateral curves
+    std::vector<float> longitudinalB, longitudinalC, longitudinalD, longitudinalE;
+    std::vector<float> lateralB, lateralC, lateralD, lateralE;
+    // state: angular speed of the wheels (rad/s)
+    std::vector<float> spin;
+    // outputs: forces along the wheel direction and the axle (N)
+    std::vector<float> forwardForce, lateralForce;
+
+    // below this speed the slips are computed with this speed, they are not defined with the car stopped
+    float LowSpeed = 2.f;
+
+    int Size() {
+        return spin.size();
+    }
+
+    // the arrays keep their memory, a batch with the same number of wheels at each step doesn't allocate
+    void Resize(int size) {
+        for(auto array: {&forwardSpeed, &lateralSpeed, &load, &drive, &brake, &radius, &inertia,
+                         &longitudinalB, &longitudinalC, &longitudinalD, &longitudinalE,
+                         &lateralB, &lateralC, &lateralD, &lateralE, &spin, &forwardForce, &lateralForce}) {
+            array->resize(size);
+        }
+    }
+
+    void Evaluate(float timeStep) {
+#ifdef TYRE_MODEL_SSE
+        int size = Size();
+        Lanes lanes = arrays();
+        __m128 h = _mm_set1_ps(timeStep), lowSpeed = _mm_set1_ps(LowSpeed);
+        int blocks = size & ~3;
+        for(int i = 0; i < blocks; i += 4) {
+            evaluate4(lanes, i, h, lowSpeed);
+        }
+        if(blocks == size) return;
+
+        // the last wheels are copied in a full block, the unused lanes have no load and no speed
+        float padded[LANE_ARRAYS][4];
+        const float *columns[LANE_ARRAYS];
+        lanes.columns(columns);
+        for(int a = 0; a < LANE_ARRAYS; a++) {
+            for(int k = 0; k < 4; k++) {
+                padded[a][k] = blocks + k < size ? columns[a][blocks + k] : 1.f;
+            }
+        }
+        for(int k = size - blocks; k < 4; k++) padded[LANE_LOAD][k] = 0.f;
+        Lanes tail;
+        tail.fromColumns(padded);
+        evaluate4(tail, 0, h, lowSpeed);
+        for(int k = 0; k < size - blocks; k++) {
+            spin[blocks + k] = padded[LANE_SPIN][k];
+            forwardForce[blocks + k] = padded[LANE_FORWARD_FORCE][k];
+            lateralForce[blocks + k] = padded[LANE_LATERAL_FORCE][k];
+        }
+#else
+        EvaluateScalar(timeStep);
+#endif
+    }
+
+    void EvaluateScalar(float timeStep) {
+        int size = Size();
+        // locals and plain pointers, so the loop doesn't read the members through this at each wheel
+        const float lowSpeed = LowSpeed;
+        const float *vx = forwardSpeed.data(), *vy = lateralSpeed.data(), *fz = load.data();
+        const float *driveForce = drive.data(), *brakeForce = brake.data(), *r = radius.data(), *wheelInertia = inertia.data();
+        const float *bx = longitudinalB.data(), *cx = longitudinalC.data(), *dx = longitudinalD.data(), *ex = longitudinalE.data();
+        const float *by = lateralB.data(), *cy = lateralC.data(), *dy = lateralD.data(), *ey = lateralE.data();
+        float *omega = spin.data(), *fx = forwardForce.data(), *fy = lateralForce.data();
+        for(int i = 0; i < size; i++) {
+            float speed = std::max(std::fabs(vx[i]), lowSpeed);
+            float slipRatio = (omega[i] * r[i] - vx[i]) / speed;
+            float slipAngle = std::atan(vy[i] / speed);
+
+            float longitudinal = bx[i] * slipRatio;
+            float lateral = by[i] * slipAngle;
+            float forceX = fz[i] * dx[i] * std::sin(cx[i] * std::atan(longitudinal - ex[i] * (longitudinal - std::atan(longitudinal))));
+            // the lateral force is against the lateral speed
+            float forceY = -fz[i] * dy[i] * std::sin(cy[i] * std::atan(lateral - ey[i] * (lateral - std::atan(lateral))));
+
+            // combined slip: the total force stays inside the friction circle of the tyre
+            float peak = fz[i] * std::max(dx[i], dy[i]);
+            float scale = std::min(1.f, peak / std::sqrt(forceX * forceX + forceY * forceY + 1e-6f));
+            fx[i] = forceX * scale;
+            fy[i] = forceY * scale;
+
+            // the spin is integrated implicitly on the steepest slope of the longitudinal curve (B * C * D * load):
+            // at low speed the tyre is very stiff, and an explicit step would oscillate
+            float slope = bx[i] * cx[i] * dx[i] * fz[i];
+            float torque = (driveForce[i] - fx[i]) * r[i];
+            float spinChange = timeStep * torque / wheelInertia[i] / (1.f + timeStep * slope * r[i] * r[i] / (wheelInertia[i] * speed));
+            float newSpin = omega[i] + spinChange;
+            // the brake slows the wheel down to zero, never reversing it
+            float brakeChange = timeStep * brakeForce[i] * r[i] / wheelInertia[i];
+            omega[i] = std::copysign(std::max(std::fabs(newSpin) - brakeChange, 0.f), newSpin);
+        }
+    }
+
+private:
+    // the arrays of the batch in the order of Lanes
+    enum {
+        LANE_FORWARD_SPEED, LANE_LATERAL_SPEED, LANE_LOAD, LANE_DRIVE, LANE_BRAKE, LANE_RADIUS, LANE_INERTIA,
+        LANE_LONGITUDINAL_B, LANE_LONGITUDINAL_C, LANE_LONGITUDINAL_D, LANE_LONGITUDINAL_E,
+        LANE_LATERAL_B, LANE_LATERAL_C, LANE_LATERAL_D, LANE_LATERAL_E,
+        LANE_SPIN, LANE_FORWARD_FORCE, LANE_LATERAL_FORCE, LANE_ARRAYS
+    };
+
+    struct Lanes {
+        const float *vx, *vy, *fz, *drive, *brake, *r, *inertia;
+        const float *bx, *cx, *dx, *ex, *by, *cy, *dy, *ey;
+        float *omega, *fx, *fy;
+
+        void columns(const float *result[LANE_ARRAYS]) const {
+            const float *inputs[] = {vx, vy, fz, drive, brake, r, inertia, bx, cx, dx, ex, by, cy, dy, ey};
+            for(int a = 0; a < LANE_SPIN; a++) result[a] = inputs[a];
+            result[LANE_SPIN] = omega;
+            result[LANE_FORWARD_FORCE] = fx;
+            result[LANE_LATERAL_FORCE] = fy;
+        }
+
+        void fromColumns(float columns[LANE_ARRAYS][4]) {
+            const float **inputs[] = {&vx, &vy, &fz, &drive, &brake, &r, &inertia, &bx, &cx, &dx, &ex, &by, &cy, &dy, &ey};
+            for(int a = 0; a < LANE_SPIN; a++) *inputs[a] = columns[a];
+            omega = columns[LANE_SPIN];
+            fx = columns[LANE_FORWARD_FORCE];
+            fy = columns[LANE_LATERAL_FORCE];
+        }
+    };
+
+    Lanes arrays() {
+        return Lanes{forwardSpeed.data(), lateralSpeed.data(), load.data(), drive.data(), brake.data(), radius.data(), inertia.data(),
+                     longitudinalB.data(), longitudinalC.data(), longitudinalD.data(), longitudinalE.data(),
+                     lateralB.data(), lateralC.data(), lateralD.data(), lateralE.data(),
+                     spin.data(), forwardForce.data(), lateralForce.data()};
+    }
+
+#ifdef TYRE_MODEL_SSE
+    static __m128 absPs(__m128 x) {
+        return _mm_andnot_ps(_mm_set1_ps(-0.f), x);
+    }
+
+    // atan(x) = pi/2 - atan(1/x) for |x| > 1, on [0, 1] a polynomial in x^2 (error 1e-5 rad)
+    static __m128 atanPs(__m128 x) {
+        const __m128 one = _mm_set1_ps(1.f);
+        __m128 sign = _mm_and_ps(x, _mm_set1_ps(-0.f));
+        __m128 a = absPs(x);
+        __m128 inverted = _mm_cmpgt_ps(a, one);
+        // 1/0 is infinite, the min is 0
+        __m128 t = _mm_min_ps(a, _mm_div_ps(one, a));
+        __m128 t2 = _mm_mul_ps(t, t);
+        __m128 p = _mm_set1_ps(-0.01172120f);
+        p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(0.05265332f));
+        p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(-0.11643287f));
+        p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(0.19354346f));
+        p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(-0.33262347f));
+        p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(0.99997726f));
+        p = _mm_mul_ps(p, t);
+        __m128 result = _mm_or_ps(_mm_and_ps(inverted, _mm_sub_ps(_mm_set1_ps(SIMD_HALF_PI), p)), _mm_andnot_ps(inverted, p));
+        return _mm_or_ps(result, sign);
+    }
+
+    // sin(x) = (-1)^k sin(x - k pi), with k the closest integer to x / pi, on [-pi/2, pi/2] the Taylor polynomial
+    // up to x^11 (error 1e-7)
+    static __m128 sinPs(__m128 x) {
+        __m128i k = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.f / SIMD_PI)));
+        __m128 kf = _mm_cvtepi32_ps(k);
+        // pi in two parts, so x - k pi keeps the precision for the larger k
+        x = _mm_sub_ps(x, _mm_mul_ps(kf, _mm_set1_ps(3.140625f)));
+        x = _mm_sub_ps(x, _mm_mul_ps(kf, _mm_set1_ps(9.67653589793e-4f)));
+        __m128 x2 = _mm_mul_ps(x, x);
+        __m128 p = _mm_set1_ps(-2.5052108e-8f);
+        p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(2.7557319e-6f));
+        p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.9841270e-4f));
+        p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(8.3333333e-3f));
+        p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.6666667e-1f));
+        p = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, x2), x), x);
+        // odd k: the lowest bit of k becomes the sign bit
+        return _mm_xor_ps(p, _mm_castsi128_ps(_mm_slli_epi32(k, 31)));
+    }
+
+    // magic formula D * sin(C * atan(B * slip - E * (B * slip - atan(B * slip)))) for the product B * slip
+    static __m128 magicFormulaPs(__m128 bSlip, __m128 c, __m128 d, __m128 e) {
+        __m128 inner = _mm_sub_ps(bSlip, _mm_mul_ps(e, _mm_sub_ps(bSlip, atanPs(bSlip))));
+        return _mm_mul_ps(d, sinPs(_mm_mul_ps(c, atanPs(inner))));
+    }
+
+    // the same steps of EvaluateScalar, for the wheels i to i + 3
+    static void evaluate4(const Lanes &w, int i, __m128 h, __m128 lowSpeed) {
+        const __m128 one = _mm_set1_ps(1.f);
+        __m128 vx = _mm_loadu_ps(w.vx + i), vy = _mm_loadu_ps(w.vy + i), fz = _mm_loadu_ps(w.fz + i);
+        __m128 r = _mm_loadu_ps(w.r + i), inertia = _mm_loadu_ps(w.inertia + i), omega = _mm_loadu_ps(w.omega + i);
+        __m128 bx = _mm_loadu_ps(w.bx + i), cx = _mm_loadu_ps(w.cx + i), dx = _mm_loadu_ps(w.dx + i);
+        __m128 by = _mm_loadu_ps(w.by + i), dy = _mm_loadu_ps(w.dy + i);
+
+        __m128 speed = _mm_max_ps(absPs(vx), lowSpeed);
+        __m128 slipRatio = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(omega, r), vx), speed);
+        __m128 slipAngle = atanPs(_mm_div_ps(vy, speed));
+
+        __m128 forceX = _mm_mul_ps(fz, magicFormulaPs(_mm_mul_ps(bx, slipRatio), cx, dx, _mm_loadu_ps(w.ex + i)));
+        // the lateral force is against the lateral speed
+        __m128 forceY = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(fz, magicFormulaPs(_mm_mul_ps(by, slipAngle), _mm_loadu_ps(w.cy + i), dy, _mm_loadu_ps(w.ey + i))));
+
+        // combined slip: the total force stays inside the friction circle of the tyre
+        __m128 peak = _mm_mul_ps(fz, _mm_max_ps(dx, dy));
+        __m128 magnitude = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(forceX, forceX), _mm_mul_ps(forceY, forceY)), _mm_set1_ps(1e-6f)));
+        __m128 scale = _mm_min_ps(one, _mm_div_ps(peak, magnitude));
+        __m128 fx = _mm_mul_ps(forceX, scale);
+        _mm_storeu_ps(w.fx + i, fx);
+        _mm_storeu_ps(w.fy + i, _mm_mul_ps(forceY, scale));
+
+        // implicit integration of the spin, as in EvaluateScalar
+        __m128 slope = _mm_mul_ps(_mm_mul_ps(bx, cx), _mm_mul_ps(dx, fz));
+        __m128 torque = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(w.drive + i), fx), r);
+        __m128 damping = _mm_add_ps(one, _mm_div_ps(_mm_mul_ps(_mm_mul_ps(h, slope), _mm_mul_ps(r, r)), _mm_mul_ps(inertia, speed)));
+        __m128 spinChange = _mm_div_ps(_mm_div_ps(_mm_mul_ps(h, torque), inertia), damping);
+        __m128 newSpin = _mm_add_ps(omega, spinChange);
+        // the brake slows the wheel down to zero, never reversing it
+        __m128 brakeChange = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(h, _mm_loadu_ps(w.brake + i)), r), inertia);
+        __m128 magnitudeSpin = _mm_max_ps(_mm_sub_ps(absPs(newSpin), brakeChange), _mm_setzero_ps());
+        _mm_storeu_ps(w.omega + i, _mm_or_ps(magnitudeSpin, _mm_and_ps(newSpin, _mm_set1_ps(-0.f))));
+    }
+#endif
+};
+
+// Tyre model of the vehicles: replaces the friction of btRaycastVehicle (m_frictionSlip) with the forces of a
+// TyreBatch, evaluated for all the wheels of all the vehicles in one pass and applied as impulses on the chassis.
+// The vehicles added here are substepped together (with Substeps substeps for each internal step of the world):
+// at each substep every vehicle updates its suspension, then the batch gives the tyre forces of all the wheels.
+// Engine and brake forces of the wheels become the drive and brake forces of the batch, btRaycastVehicle sees them
+// at zero with no friction, so it applies only the suspension.
+class TyreModel {
+public:
+    TyreModel(Physics &simulation): simulation(simulation) {
+        tickCallback = simulation.AddTickCallback([this](btScalar timeStep) { step(timeStep); }, true);
+    }
+
+    ~TyreModel() {
+        simulation.RemoveTickCallback(tickCallback);
+        for(auto vehicle: vehicles) vehicle->SetTyreModel(nullptr);
+    }
+
+    TyreModel(const TyreModel& copy) = delete; //disallow copy
+    TyreModel& operator=(const TyreModel &) = delete;
+
+    void Add(Vehicle &vehicle) {
+        vehicle.SetTyreModel(this);
+        vehicles.push_back(&vehicle);
+        // the wheels start rolling with the chassis
+        float speed = vehicle.GetBulletVehicle().getCurrentSpeedKmHour() / 3.6f;
+        for(int w = 0; w < vehicle.WheelSpin.size(); w++) {
+            vehicle.WheelSpin[w] = speed / vehicle.GetBulletVehicle().getWheelInfo(w).m_wheelsRadius;
+        }
+        resize();
+    }
+
+    void Remove(Vehicle &vehicle) {
+        auto found = std::find(vehicles.begin(), vehicles.end(), &vehicle);
+        if(found == vehicles.end()) return;
+        vehicles.erase(found);
+        vehicle.SetTyreModel(nullptr);
+        resize();
+    }
+
+    TyreBatch Batch;
+    // substeps of the vehicles for each internal step of the world
+    int Substeps = 4;
+    // mass of a wheel (kg), for its inertia
+    float WheelMass = 20.f;
+    // time of the last evaluation of the batch (ms)
+    float EvaluateTime = 0.f;
+
+private:
+    Physics &simulation;
+    int tickCallback;
+    std::vector<Vehicle*> vehicles;
+    // directions of the wheels on the ground, for the impulses
+    btAlignedObjectArray<btVector3> axles, forwards;
+
+    void resize() {
+        int size = 0;
+        for(auto vehicle: vehicles) size += vehicle->GetBulletVehicle().getNumWheels();
+        Batch.Resize(size);
+        axles.resize(size);
+        forwards.resize(size);
+    }
+
+    void step(btScalar timeStep) {
+        if(vehicles.empty()) return;
+        int substeps = btMax(Substeps, 1);
+        btScalar substepTime = timeStep / substeps;
+
+        // drive and brake are moved to the batch, btRaycastVehicle runs with no engine, brake and friction
+        int index = 0;
+        for(auto vehicle: vehicles) {
+            auto &bulletVehicle = vehicle->GetBulletVehicle();
+            auto &info = vehicle->WheelInfo;
+            for(int w = 0; w < bulletVehicle.getNumWheels(); w++, index++) {
+                btWheelInfo &wheel = bulletVehicle.getWheelInfo(w);
+                // the spin is kept by the vehicle (and saved with its state), the batch has a copy during the step
+                Batch.spin[index] = vehicle->WheelSpin[w];
+                Batch.drive[index] = wheel.m_engineForce;
+                Batch.brake[index] = wheel.m_brake;
+                wheel.m_engineForce = 0.f;
+                wheel.m_brake = 0.f;
+                wheel.m_frictionSlip = 0.f;
+                Batch.radius[index] = wheel.m_wheelsRadius;
+                Batch.inertia[index] = .5f * WheelMass * wheel.m_wheelsRadius * wheel.m_wheelsRadius;
+                Batch.longitudinalB[index] = info.longitudinal.B;
+                Batch.longitudinalC[index] = info.longitudinal.C;
+                Batch.longitudinalD[index] = info.longitudinal.D;
+                Batch.longitudinalE[index] = info.longitudinal.E;
+                Batch.lateralB[index] = info.lateral.B;
+                Batch.lateralC[index] = info.lateral.C;
+                Batch.lateralD[index] = info.lateral.D;
+                Batch.lateralE[index] = info.lateral.E;
+            }
+            vehicle->BeginSubsteps();
+        }
+
+        float evaluateTime = 0.f;
+        for(int i = 0; i < substeps; i++) {
+            for(auto vehicle: vehicles) {
+                vehicle->Substep(i, substepTime);
+            }
+            gather();
+            btClock clock;
+            Batch.Evaluate(substepTime);
+            evaluateTime += clock.getTimeMicroseconds() / 1000.f;
+            apply(substepTime);
+        }
+        EvaluateTime = evaluateTime;
+
+        index = 0;
+        for(auto vehicle: vehicles) {
+            vehicle->EndSubsteps(substeps, substepTime);
+            auto &bulletVehicle = vehicle->GetBulletVehicle();
+            for(int w = 0; w < bulletVehicle.getNumWheels(); w++, index++) {
+                btWheelInfo &wheel = bulletVehicle.getWheelInfo(w);
+                wheel.m_engineForce = Batch.drive[index];
+                wheel.m_brake = Batch.brake[index];
+                vehicle->WheelSpin[w] = Batch.spin[index];
+            }
+        }
+    }
+
+    // speeds and loads of the wheels after the suspension of the substep
+    void gather() {
+        int index = 0;
+        for(auto vehicle: vehicles) {
+            auto &bulletVehicle = vehicle->GetBulletVehicle();
+            btRigidBody *chassis = bulletVehicle.getRigidBody();
+            for(int w = 0; w < bulletVehicle.getNumWheels(); w++, index++) {
+                btWheelInfo &wheel = bulletVehicle.getWheelInfo(w);
+                if(!wheel.m_raycastInfo.m_isInContact) {
+                    Batch.load[index] = Batch.forwardSpeed[index] = Batch.lateralSpeed[index] = 0.f;
+                    continue;
+                }
+                // the same directions of btRaycastVehicle::updateFriction: the axle on the ground and the forward
+                const btVector3 &normal = wheel.m_raycastInfo.m_contactNormalWS;
+                btVector3 axle = -bulletVehicle.getWheelTransformWS(w).getBasis().getColumn(bulletVehicle.getRightAxis());
+                axle -= normal * axle.dot(normal);
+                axle.normalize();
+                axles[index] = axle;
+                forwards[index] = normal.cross(axle);
+
+                btVector3 velocity = chassis->getVelocityInLocalPoint(wheel.m_raycastInfo.m_contactPointWS - chassis->getCenterOfMassPosition());
+                Batch.forwardSpeed[index] = velocity.dot(forwards[index]);
+                Batch.lateralSpeed[index] = velocity.dot(axle);
+                Batch.load[index] = wheel.m_wheelsSuspensionForce;
+            }
+        }
+    }
+
+    // the tyre forces of the substep as impulses on the chassis
+    void apply(btScalar substepTime) {
+        int index = 0;
+        for(auto vehicle: vehicles) {
+            auto &bulletVehicle = vehicle->GetBulletVehicle();
+            btRigidBody *chassis = bulletVehicle.getRigidBody();
+            btVector3 chassisUp = chassis->getCenterOfMassTransform().getBasis().getColumn(bulletVehicle.getUpAxis());
+            for(int w = 0; w < bulletVehicle.getNumWheels(); w++, index++) {
+                btWheelInfo &wheel = bulletVehicle.getWheelInfo(w);
+                if(!wheel.m_raycastInfo.m_isInContact) continue;
+                btVector3 impulse = (forwards[index] * Batch.forwardForce[index] + axles[index] * Batch.lateralForce[index]) * substepTime;
+                // as btRaycastVehicle, the forces are applied closer to the center of mass to limit the roll
+                btVector3 relativePosition = wheel.m_raycastInfo.m_contactPointWS - chassis->getCenterOfMassPosition();
+                relativePosition -= chassisUp * (chassisUp.dot(relativePosition) * (1.f - wheel.m_rollInfluence));
+                chassis->applyImpulse(impulse, relativePosition);
+            }
+        }
+    }
+};
@@ -3,6 +3,15 @@
 #include <bullet/btBulletDynamicsCommon.h>
 #include <glm/glm.hpp>
 #include <utils/physics.h>
+#include <utils/projectile_pool.h>
+#include <utils/vehicle_raycaster.h>
+
+#include <vector>
+
+class TyreModel;
+
+// maximum number of projectiles shot by a vehicle that can be in the world at the same time
+constexpr int PROJECTILE_POOL_SIZE = 32;
 
 struct WheelInfo {
     float gVehicleSteering = 0.f;
@@ -18,23 +27,55 @@ struct WheelInfo {
 
     float radius = 0.4f;
     float width = 0.3f;
+
+    // coefficients of the magic formula of the tyres, used instead of friction when the vehicle
+    // is driven by a TyreModel (D is the peak friction coefficient)
+    struct TyreCoefficients {
+        float B, C, D, E;
+    };
+    TyreCoefficients longitudinal {10.f, 1.65f, 1.f, .97f};
+    TyreCoefficients lateral {10.f, 1.3f, 1.f, .97f};
+};
+
+// btRaycastVehicle updated by the Vehicle class with substeps (see Vehicle::substep): it stays an action of the
+// world only for the debug drawing of the wheels
+class SubsteppedRaycastVehicle : public btRaycastVehicle {
+public:
+    using btRaycastVehicle::btRaycastVehicle;
+
+    void updateAction(btCollisionWorld *, btScalar) override {}
+};
+
+// state of the vehicle not kept in the rigid body of the chassis, saved by a WorldSnapshot
+struct VehicleState {
+    btAlignedObjectArray<btWheelInfo> wheels;
+    float steering;
+    float shootTimer;
+    std::vector<float> projectileAges;
+    std::vector<float> wheelSpins;
 };
 
 class Vehicle {
 public:
-    Vehicle(const glm::vec3 &chassisBoxSize, const WheelInfo &wheelInfo): WheelInfo(wheelInfo), vehicle(vehicle) {
+    // projectilePoolSize is 0 for the vehicles that never shoot (e.g. the AI opponents), they don't allocate projectiles
+    Vehicle(Physics &bulletSimulation, const glm::vec3 &chassisBoxSize, const WheelInfo &wheelInfo, int projectilePoolSize = PROJECTILE_POOL_SIZE):
+        WheelInfo(wheelInfo), simulation(bulletSimulation), vehicle(vehicle), projectiles(bulletSimulation, projectilePoolSize, 0.2f, 1.0f, 0.3f, 0.3f) {
         btTransform tr;
         chassisBox = btVector3(chassisBoxSize.x, chassisBoxSize.y, chassisBoxSize.z);
-        Physics &bulletSimulation = Physics::GetInstance();
         btCollisionShape *chassisShape = new btBoxShape(chassisBox);
-        Chassis = bulletSimulation.localCreateRigidBody(800, tr, chassisShape);
-        auto vehicleRayCaster = new btDefaultVehicleRaycaster(bulletSimulation.dynamicsWorld);
+        bulletSimulation.collisionShapes.push_back(chassisShape);
+        Chassis = bulletSimulation.localCreateRigidBody(800, tr, chassisShape, COLLISION_VEHICLE);
+        // the wheels are cast as a batch, instead of a world raycast for each wheel
+        vehicleRayCaster = new BatchedVehicleRaycaster(bulletSimulation.dynamicsWorld, Chassis);
         btRaycastVehicle::btVehicleTuning tuning;
-        vehicle = btRaycastVehicle(tuning, Chassis, vehicleRayCaster);
+        vehicle = SubsteppedRaycastVehicle(tuning, Chassis, vehicleRayCaster);
+        vehicleRayCaster->SetVehicle(&vehicle);
         //never deactivate the vehicle
         Chassis->setActivationState(DISABLE_DEACTIVATION);
 
         bulletSimulation.dynamicsWorld->addVehicle(&vehicle);
+        // suspension, friction and engine are updated before each internal step of the world
+        substepCallback = bulletSimulation.AddTickCallback([this](btScalar timeStep) { substep(timeStep); }, true);
         
         float connectionHeight = wheelInfo.radius;
 
@@ -58,6 +99,7 @@ public:
         vehicle.addWheel(connectionPointCS0, wheelDirectionCS0, wheelAxleCS, wheelInfo.suspensionRestLength, wheelInfo.radius, tuning, false);
     
         updateWheelProperty();
+        WheelSpin.resize(vehicle.getNumWheels(), 0.f);
 
         // reset chassis
         Chassis->setCenterOfMassTransform(btTransform::getIdentity());
@@ -69,6 +111,18 @@ public:
         updateWheelTransform();
     }
 
+    ~Vehicle() {
+        simulation.RemoveTickCallback(substepCallback);
+        // the world can be already deleted (Physics::Clear), in that case the chassis has been deleted by the world
+        if(simulation.dynamicsWorld) {
+            simulation.dynamicsWorld->removeVehicle(&vehicle);
+        }
+        delete vehicleRayCaster;
+    }
+
+    Vehicle(const Vehicle& copy) = delete; //disallow copy
+    Vehicle& operator=(const Vehicle &) = delete;
+
     btRigidBody *Chassis;
     WheelInfo WheelInfo;
     // time to shoot again
@@ -76,6 +130,11 @@ public:
     float EngineForce = 0.f;
     float BreakingForce = 0.f;
     float Steering = 0.f;
+    // updates of suspension, friction and engine for each internal step of the world: stiff suspensions are
+    // stable without a higher rate for the whole world
+    int Substeps = 4;
+    // angular speed of the wheels (rad/s), integrated by the TyreModel
+    std::vector<float> WheelSpin;
 
     // HACK: kinda hack, we do this to use the transformation of the chassis and the wheel... we should return them?
     btRaycastVehicle &GetBulletVehicle() {
@@ -106,16 +165,10 @@ public:
 
     void Shoot() {
         if(shootTimer > 0.f) return;
-        // TODO: HACK: shared with main (draw) if we want to keep this we should refactor this in a separate class
-        glm::vec3 sphereSize = glm::vec3(0.2f, 0.2f, 0.2f);
 
         // reset the timer
         shootTimer = ShootCooldown;
 
-        Physics &bulletSimulation = Physics::GetInstance();
-
-        // we need a initial rotation, even if useless for a sphere
-        glm::vec3 rot = glm::vec3(0.0f, 0.0f, 0.0f);
         // initial velocity of the bullet
         float shootInitialSpeed = 30.0f;
         btVector3 shootDirection(0.f, 0.f, 5.f);
@@ -123,10 +176,9 @@ public:
         auto transform = vehicle.getChassisWorldTransform(); 
         // spawn position of the bullet
         auto spherePosition = transform * shootDirection;
-        // TODO: use toGLM function from main
-        glm::vec3 position(spherePosition.getX(), spherePosition.getY(), spherePosition.getZ());
-        // rigid body of the bullet, we create a Rigid Body with mass = 1
-        btRigidBody *sphere = bulletSimulation.createRigidBody(SPHERE, position, sphereSize, rot, 1.0f, 0.3f, 0.3f);
+        // rigid body of the bullet, taken from the pool (sphere of radius 0.2 with mass = 1)
+        btRigidBody *sphere = projectiles.Spawn(spherePosition);
+        if(!sphere) return;
 
         // we apply the impulse and shoot the bullet in the scene
         // N.B.) the graphical aspect of the bullet is treated in the rendering loop
@@ -149,6 +201,8 @@ public:
     void Update(float deltaTime) {
         // decrease bullet cooldown
         shootTimer -= deltaTime;
+        // remove from the world old bullets and the ones too far from the vehicle
+        projectiles.Update(deltaTime, vehicle.getChassisWorldTransform().getOrigin());
         
         // lineary resetting the steering angle to 0 until ge straight again
         float newAngle = Steering;
@@ -183,10 +237,72 @@ public:
         isSteering = false;
     }
 
+    void SaveState(VehicleState &state) {
+        state.wheels.clear();
+        for(int i = 0; i < vehicle.getNumWheels(); i++) {
+            state.wheels.push_back(vehicle.getWheelInfo(i));
+        }
+        state.steering = Steering;
+        state.shootTimer = shootTimer;
+        state.wheelSpins = WheelSpin;
+        projectiles.SaveState(state.projectileAges);
+    }
+
+    // the chassis is restored with all the other rigid bodies, here only the wheels and the projectiles
+    void RestoreState(const VehicleState &state) {
+        for(int i = 0; i < vehicle.getNumWheels(); i++) {
+            vehicle.getWheelInfo(i) = state.wheels[i];
+        }
+        Steering = state.steering;
+        shootTimer = state.shootTimer;
+        WheelSpin = state.wheelSpins;
+        projectiles.RestoreState(state.projectileAges);
+    }
+
     glm::vec3 getChassisSize() {
         return glm::vec3(chassisBox.getX(), chassisBox.getY(), chassisBox.getZ());
     }
 
+    BatchedVehicleRaycaster &GetRaycaster() {
+        return *vehicleRayCaster;
+    }
+
+    ProjectilePool &GetProjectiles() {
+        return projectiles;
+    }
+
+    // the substeps of a step of the world (see substep), public for the TyreModel
+    void BeginSubsteps() {
+        substepStart = Chassis->getWorldTransform();
+    }
+
+    void Substep(int i, btScalar substepTime) {
+        if(i > 0) {
+            Chassis->setLinearVelocity(Chassis->getLinearVelocity() + Chassis->getGravity() * substepTime);
+            btTransform predicted;
+            Chassis->predictIntegratedTransform(substepTime, predicted);
+            Chassis->setWorldTransform(predicted);
+            Chassis->updateInertiaTensor();
+        }
+        vehicle.updateVehicle(substepTime);
+    }
+
+    void EndSubsteps(int substeps, btScalar substepTime) {
+        // the gravity of the whole step is applied by the world
+        Chassis->setLinearVelocity(Chassis->getLinearVelocity() - Chassis->getGravity() * substepTime * (substeps - 1));
+        Chassis->setWorldTransform(substepStart);
+        Chassis->updateInertiaTensor();
+    }
+
+    // set by TyreModel::Add, the vehicle is substepped by the tyre model (nullptr to go back to the friction)
+    void SetTyreModel(TyreModel *model) {
+        tyreModel = model;
+    }
+
+    TyreModel *GetTyreModel() {
+        return tyreModel;
+    }
+
     // public for imgui tweeking
     float maxEngineForce = 2000.f;
 private:
@@ -195,7 +311,30 @@ private:
     const float steeringIncrement = 4.f;
     const float steeringClamp = 0.5f;
     bool isSteering;
-    btRaycastVehicle vehicle;
+    Physics &simulation;
+    BatchedVehicleRaycaster *vehicleRayCaster;
+    SubsteppedRaycastVehicle vehicle;
+    ProjectilePool projectiles;
+    int substepCallback;
+    TyreModel *tyreModel = nullptr;
+    btTransform substepStart;
+
+    // Updates the vehicle with Substeps steps of timeStep / Substeps before the step of the world.
+    // At each substep the wheels are cast from the pose of the chassis predicted at that time, with the velocity
+    // changed by the impulses of the previous substeps (and the gravity), so the suspension forces follow the
+    // compression inside the step. Then the chassis goes back to its pose: the world integrates it (and solves
+    // its contacts) from there, with the velocity given by all the substeps.
+    void substep(btScalar timeStep) {
+        // the tyre model substeps all its vehicles together
+        if(tyreModel) return;
+        int substeps = btMax(Substeps, 1);
+        btScalar substepTime = timeStep / substeps;
+        BeginSubsteps();
+        for(int i = 0; i < substeps; i++) {
+            Substep(i, substepTime);
+        }
+        EndSubsteps(substeps, substepTime);
+    }
 
     void updateWheelProperty() {
         for (int i = 0; i < vehicle.getNumWheels(); i++) {
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+
+#include <bullet/btBulletDynamicsCommon.h>
+#include <bullet/LinearMath/btAabbUtil2.h>
+
+// Raycaster of the wheels of a vehicle, it replaces btDefaultVehicleRaycaster.
+// The default raycaster makes a full dynamicsWorld->rayTest for each wheel: each ray walks the
+// broadphase tree and then the BVH of every object it crosses.
+// Here the rays of all the wheels are cast as a batch, when the vehicle asks for the first wheel:
+// - a single broadphase query with the AABB enclosing all the rays collects the candidate objects
+// - boxes, spheres and planes (the ground, the cubes, the projectiles) are tested analytically
+// - the other shapes (the racetrack and the obstacles, the snow heightfield) use the BVH of the
+//   shape through rayTestSingle, only for the rays crossing their AABB and clipped by the closest
+//   analytic hit, so most of the BVH is never visited
+// The results are then returned to the vehicle one wheel at a time.
+class BatchedVehicleRaycaster : public btVehicleRaycaster {
+public:
+    BatchedVehicleRaycaster(btDynamicsWorld *world, btCollisionObject *chassis): world(world), chassis(chassis) {}
+
+    // the vehicle whose wheels are cast, set after the vehicle is created with this raycaster
+    void SetVehicle(btRaycastVehicle *raycastVehicle) {
+        vehicle = raycastVehicle;
+    }
+
+    void *castRay(const btVector3 &from, const btVector3 &to, btVehicleRaycasterResult &result) override {
+        // btRaycastVehicle::updateVehicle computes the transforms of all the wheels before casting
+        // the first one, so at the first wheel the rays of the whole batch are already known
+        if(cursor == 0) {
+            castBatch();
+        }
+        WheelRay *ray = nullptr;
+        if(cursor < rays.size() && rays[cursor].from == from && rays[cursor].to == to) {
+            ray = &rays[cursor];
+        } else {
+            // a ray not in the batch (e.g. rayCast called outside the vehicle update)
+            cursor = 0;
+            FallbackRays++;
+            return castSingle(from, to, result);
+        }
+        cursor = (cursor + 1) % rays.size();
+
+        if(!ray->hit) return nullptr;
+        result.m_hitPointInWorld = ray->hitPoint;
+        result.m_hitNormalInWorld = ray->hitNormal;
+        result.m_distFraction = ray->fraction;
+        return (void*) ray->hit;
+    }
+
+    // objects found by the broadphase query of the last batch
+    int Candidates = 0;
+    // rays cast one at a time, because they were not part of a batch
+    int FallbackRays = 0;
+
+private:
+    struct WheelRay {
+        btVector3 from;
+        btVector3 to;
+        const btRigidBody *hit;
+        btVector3 hitPoint;
+        btVector3 hitNormal;
+        btScalar fraction;
+    };
+
+    // collects the objects overlapping the AABB of the batch
+    struct CandidateCallback : public btBroadphaseAabbCallback {
+        std::vector<btCollisionObject*> *objects;
+
+        bool process(const btBroadphaseProxy *proxy) override {
+            objects->push_back((btCollisionObject*) proxy->m_clientObject);
+            return true;
+        }
+    };
+
+    btDynamicsWorld *world;
+    btCollisionObject *chassis;
+    btRaycastVehicle *vehicle = nullptr;
+    std::vector<WheelRay> rays;
+    std::vector<btCollisionObject*> candidates;
+    int cursor = 0;
+
+    void castBatch() {
+        rays.resize(vehicle->getNumWheels());
+        btVector3 batchMin(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+        btVector3 batchMax(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+        for(int i = 0; i < rays.size(); i++) {
+            // the same ray of btRaycastVehicle::rayCast
+            const btWheelInfo &wheel = vehicle->getWheelInfo(i);
+            btScalar rayLength = wheel.getSuspensionRestLength() + wheel.m_wheelsRadius;
+            rays[i].from = wheel.m_raycastInfo.m_hardPointWS;
+            rays[i].to = rays[i].from + wheel.m_raycastInfo.m_wheelDirectionWS * rayLength;
+            rays[i].hit = nullptr;
+            rays[i].fraction = btScalar(1.);
+            batchMin.setMin(rays[i].from);
+            batchMin.setMin(rays[i].to);
+            batchMax.setMax(rays[i].from);
+            batchMax.setMax(rays[i].to);
+        }
+
+        candidates.clear();
+        CandidateCallback callback;
+        callback.objects = &candidates;
+        world->getBroadphase()->aabbTest(batchMin, batchMax, callback);
+        Candidates = candidates.size();
+
+        // first the analytic shapes, then the others are clipped by the closest hits already found
+        for(auto object: candidates) {
+            if(!accepted(object) || !isAnalytic(object->getCollisionShape())) continue;
+            for(auto &ray: rays) {
+                castAnalytic(ray, object);
+            }
+        }
+        for(auto object: candidates) {
+            if(!accepted(object) || isAnalytic(object->getCollisionShape())) continue;
+            // the AABB already computed by the broadphase
+            btBroadphaseProxy *proxy = object->getBroadphaseHandle();
+            for(auto &ray: rays) {
+                castShape(ray, object, proxy->m_aabbMin, proxy->m_aabbMax);
+            }
+        }
+    }
+
+    // the same objects hit by btDefaultVehicleRaycaster: rigid bodies with contact response that
+    // pass the collision filter of a default ray, but never the chassis where the rays start
+    bool accepted(btCollisionObject *object) {
+        if(object == chassis || !object->hasContactResponse() || !btRigidBody::upcast(object)) return false;
+        btBroadphaseProxy *proxy = object->getBroadphaseHandle();
+        return (proxy->m_collisionFilterGroup & btBroadphaseProxy::AllFilter) &&
+               (btBroadphaseProxy::DefaultFilter & proxy->m_collisionFilterMask);
+    }
+
+    bool isAnalytic(const btCollisionShape *shape) {
+        int type = shape->getShapeType();
+        return type == BOX_SHAPE_PROXYTYPE || type == SPHERE_SHAPE_PROXYTYPE || type == STATIC_PLANE_PROXYTYPE;
+    }
+
+    void setHit(WheelRay &ray, btCollisionObject *object, btScalar fraction, const btVector3 &normal) {
+        ray.hit = btRigidBody::upcast(object);
+        ray.fraction = fraction;
+        ray.hitPoint = ray.from.lerp(ray.to, fraction);
+        ray.hitNormal = normal;
+    }
+
+    // intersection with the front faces of boxes, spheres and planes, in the space of the shape
+    void castAnalytic(WheelRay &ray, btCollisionObject *object) {
+        const btTransform &transform = object->getWorldTransform();
+        btVector3 from = transform.invXform(ray.from);
+        btVector3 direction = transform.getBasis().transpose() * (ray.to - ray.from);
+        const btCollisionShape *shape = object->getCollisionShape();
+
+        switch(shape->getShapeType()) {
+            case BOX_SHAPE_PROXYTYPE: {
+                // slab test, the ray must enter the box from a face (rays starting inside don't hit, as in Bullet)
+                btVector3 extents = ((const btBoxShape*) shape)->getHalfExtentsWithMargin();
+                btScalar enter = -BT_LARGE_FLOAT, exit = ray.fraction;
+                int enterAxis = -1;
+                btScalar enterSign = 0;
+                for(int axis = 0; axis < 3; axis++) {
+                    if(btFabs(direction[axis]) < SIMD_EPSILON) {
+                        if(btFabs(from[axis]) > extents[axis]) return;
+                        continue;
+                    }
+                    btScalar slabEnter = (-extents[axis] - from[axis]) / direction[axis];
+                    btScalar slabExit = (extents[axis] - from[axis]) / direction[axis];
+                    btScalar sign = -1;
+                    if(slabEnter > slabExit) {
+                        btSwap(slabEnter, slabExit);
+                        sign = 1;
+                    }
+                    if(slabEnter > enter) {
+                        enter = slabEnter;
+                        enterAxis = axis;
+                        enterSign = sign;
+                    }
+                    exit = btMin(exit, slabExit);
+                }
+                if(enterAxis < 0 || enter < 0 || enter > exit) return;
+                btVector3 normal(0, 0, 0);
+                normal[enterAxis] = enterSign;
+                setHit(ray, object, enter, transform.getBasis() * normal);
+                break;
+            }
+            case SPHERE_SHAPE_PROXYTYPE: {
+                btScalar radius = ((const btSphereShape*) shape)->getRadius();
+                btScalar a = direction.length2();
+                btScalar b = from.dot(direction);
+                btScalar c = from.length2() - radius * radius;
+                btScalar discriminant = b * b - a * c;
+                if(c < 0 || discriminant < 0) return;
+                btScalar fraction = (-b - btSqrt(discriminant)) / a;
+                if(fraction < 0 || fraction >= ray.fraction) return;
+                setHit(ray, object, fraction, transform.getBasis() * (from + direction * fraction).normalized());
+                break;
+            }
+            case STATIC_PLANE_PROXYTYPE: {
+                auto plane = (const btStaticPlaneShape*) shape;
+                const btVector3 &normal = plane->getPlaneNormal();
+                btScalar approach = normal.dot(direction);
+                if(approach >= 0) return;
+                btScalar fraction = (plane->getPlaneConstant() - normal.dot(from)) / approach;
+                if(fraction < 0 || fraction >= ray.fraction) return;
+                setHit(ray, object, fraction, transform.getBasis() * normal);
+                break;
+            }
+        }
+    }
+
+    // generic shapes (triangle meshes, heightfields, convex hulls) with the Bullet ray test of the shape
+    void castShape(WheelRay &ray, btCollisionObject *object, const btVector3 &aabbMin, const btVector3 &aabbMax) {
+        btScalar hitLambda = ray.fraction;
+        btVector3 hitNormal;
+        if(!btRayAabb(ray.from, ray.to, aabbMin, aabbMax, hitLambda, hitNormal)) return;
+
+        btCollisionWorld::ClosestRayResultCallback callback(ray.from, ray.to);
+        // hits farther than the closest one are discarded by the shape itself
+        callback.m_closestHitFraction = ray.fraction;
+        btTransform rayFrom(btMatrix3x3::getIdentity(), ray.from);
+        btTransform rayTo(btMatrix3x3::getIdentity(), ray.to);
+        btCollisionWorld::rayTestSingle(rayFrom, rayTo, object, object->getCollisionShape(), object->getWorldTransform(), callback);
+        if(callback.m_collisionObject == object) {
+            setHit(ray, object, callback.m_closestHitFraction, callback.m_hitNormalWorld.normalized());
+        }
+    }
+
+    // the same query of btDefaultVehicleRaycaster
+    void *castSingle(const btVector3 &from, const btVector3 &to, btVehicleRaycasterResult &result) {
+        btCollisionWorld::ClosestRayResultCallback callback(from, to);
+        world->rayTest(from, to, callback);
+        if(!callback.hasHit()) return nullptr;
+        const btRigidBody *body = btRigidBody::upcast(callback.m_collisionObject);
+        if(!body || !body->hasContactResponse()) return nullptr;
+        result.m_hitPointInWorld = callback.m_hitPointWorld;
+        result.m_hitNormalInWorld = callback.m_hitNormalWorld.normalized();
+        result.m_distFraction = callback.m_closestHitFraction;
+        return (void*) body;
+    }
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <bullet/btBulletDynamicsCommon.h>
+#include <bullet/BulletCollision/BroadphaseCollision/btDbvtBroadphase.h>
+
+#include <glm/glm.hpp>
+
+#include "./physics.h"
+
+// Visibility of the bodies of a world from a camera (or from the light for the shadow map).
+// The planes of the frustum are taken from the view-projection matrix and tested against the AABB tree of the
+// btDbvtBroadphase (btDbvt::collideKDOP): a node outside a plane discards its whole subtree, so the cost of a
+// query grows with the objects on screen and not with all the objects of the world. Both the trees of the
+// broadphase are visited, the dynamic one and the fixed one with the static and sleeping objects.
+// With other broadphases the AABB of each object is tested against the planes.
+// The AABBs of the broadphase are a bit bigger than the objects, so some objects just outside are still drawn.
+class VisibilityQuery {
+public:
+    VisibilityQuery(Physics &simulation, int reservedObjects = 1024): simulation(simulation) {
+        visible.reserve(reservedObjects);
+    }
+
+    VisibilityQuery(const VisibilityQuery& copy) = delete; //disallow copy
+    VisibilityQuery& operator=(const VisibilityQuery &) = delete;
+
+    // collects the objects whose AABB intersects the frustum of the view-projection matrix
+    const btAlignedObjectArray<btCollisionObject*> &Query(const glm::mat4 &viewProjection) {
+        setPlanes(viewProjection);
+        // resize keeps the memory, clear would release it
+        visible.resize(0);
+        if(auto dbvt = dynamic_cast<btDbvtBroadphase*>(simulation.overlappingPairCache)) {
+            CollectLeaves collect(visible);
+            btDbvt::collideKDOP(dbvt->m_sets[0].m_root, normals, offsets, 6, collect);
+            btDbvt::collideKDOP(dbvt->m_sets[1].m_root, normals, offsets, 6, collect);
+        } else {
+            auto &objects = simulation.dynamicsWorld->getCollisionObjectArray();
+            for(int i = 0; i < objects.size(); i++) {
+                auto proxy = objects[i]->getBroadphaseHandle();
+                if(proxy && insideFrustum(proxy->m_aabbMin, proxy->m_aabbMax)) visible.push_back(objects[i]);
+            }
+        }
+        // sorted by address, for IsVisible
+        visible.quickSort(CompareObjects());
+        Total = simulation.dynamicsWorld->getNumCollisionObjects();
+        return visible;
+    }
+
+    // objects found by the last query
+    const btAlignedObjectArray<btCollisionObject*> &Visible() {
+        return visible;
+    }
+
+    // true if the object was found by the last query
+    bool IsVisible(const btCollisionObject *object) {
+        int first = 0, last = visible.size();
+        while(first < last) {
+            int middle = (first + last) / 2;
+            if(visible[middle] < object) first = middle + 1;
+            else last = middle;
+        }
+        return first < visible.size() && visible[first] == object;
+    }
+
+    // objects of the world at the last query
+    int Total = 0;
+
+private:
+    struct CollectLeaves : btDbvt::ICollide {
+        CollectLeaves(btAlignedObjectArray<btCollisionObject*> &objects): objects(objects) {}
+
+        void Process(const btDbvtNode *leaf) override {
+            auto proxy = (btDbvtProxy*) leaf->data;
+            objects.push_back((btCollisionObject*) proxy->m_clientObject);
+        }
+
+        btAlignedObjectArray<btCollisionObject*> &objects;
+    };
+
+    struct CompareObjects {
+        bool operator()(const btCollisionObject *a, const btCollisionObject *b) const {
+            return a < b;
+        }
+    };
+
+    Physics &simulation;
+    btAlignedObjectArray<btCollisionObject*> visible;
+    // planes of the frustum (left, right, bottom, top, near, far), a point is inside when dot(normal, point) + offset >= 0
+    btVector3 normals[6];
+    btScalar offsets[6];
+
+    // planes from the rows of the clip matrix (Gribb-Hartmann), glm matrices are column major
+    void setPlanes(const glm::mat4 &m) {
+        glm::vec4 rowX(m[0][0], m[1][0], m[2][0], m[3][0]),
+                  rowY(m[0][1], m[1][1], m[2][1], m[3][1]),
+                  rowZ(m[0][2], m[1][2], m[2][2], m[3][2]),
+                  rowW(m[0][3], m[1][3], m[2][3], m[3][3]);
+        glm::vec4 planes[6] = { rowW + rowX, rowW - rowX, rowW + rowY, rowW - rowY, rowW + rowZ, rowW - rowZ };
+        for(int i = 0; i < 6; i++) {
+            // normalized only to keep the offsets in world units, the tests need just the sign
+            float length = glm::length(glm::vec3(planes[i]));
+            normals[i] = btVector3(planes[i].x, planes[i].y, planes[i].z) / length;
+            offsets[i] = planes[i].w / length;
+        }
+    }
+
+    bool insideFrustum(const btVector3 &aabbMin, const btVector3 &aabbMax) {
+        for(int i = 0; i < 6; i++) {
+            // the corner of the box farthest along the normal
+            btVector3 corner(normals[i].x() >= 0 ? aabbMax.x() : aabbMin.x(),
+                             normals[i].y() >= 0 ? aabbMax.y() : aabbMin.y(),
+                             normals[i].z() >= 0 ? aabbMax.z() : aabbMin.z());
+            if(normals[i].dot(corner) + offsets[i] < 0) return false;
+        }
+        return true;
+    }
+};
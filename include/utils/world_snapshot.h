@@ -0,0 +1,151 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+#include <bullet/btBulletDynamicsCommon.h>
+#include <bullet/LinearMath/btSerializer.h>
+
+#include "./physics.h"
+#include "./vehicle.h"
+#include "./destructible.h"
+#include "./ai_opponents.h"
+#include "./lap_timer.h"
+
+// state of a dynamic rigid body, everything that changes during the simulation
+struct RigidBodyState {
+    btRigidBody *body;
+    btTransform worldTransform;
+    btTransform interpolationWorldTransform;
+    btVector3 linearVelocity;
+    btVector3 angularVelocity;
+    btVector3 interpolationLinearVelocity;
+    btVector3 interpolationAngularVelocity;
+    int activationState;
+    btScalar deactivationTime;
+};
+
+// Snapshot of the simulation: the state of all the dynamic bodies in a flat array and the
+// state of the vehicle (wheels and projectiles), of the destructible props (broken boxes and debris) and of the
+// AI opponents (wheels and drivers) and of the lap timer.
+// Shapes and bodies are not recreated, so a snapshot can be restored in few microseconds: it is
+// used to reset the scene, to run different tests from the same state or for rollbacks.
+// N.B.) a snapshot is valid only for the world where it was captured, bodies deleted after the
+// capture can't be restored
+class WorldSnapshot {
+public:
+    WorldSnapshot(Physics &simulation): simulation(simulation) {}
+
+    void Capture(Vehicle &vehicle, DestructibleProps *props = nullptr, AiOpponents *opponents = nullptr, LapTimer *lapTimer = nullptr) {
+        auto start = std::chrono::high_resolution_clock::now();
+        auto world = simulation.dynamicsWorld;
+        bodies.clear();
+        auto &objects = world->getCollisionObjectArray();
+        for(int i = 0; i < objects.size(); i++) {
+            btRigidBody *body = btRigidBody::upcast(objects[i]);
+            // static bodies never change
+            if(!body || body->isStaticObject()) continue;
+            RigidBodyState state;
+            state.body = body;
+            state.worldTransform = body->getWorldTransform();
+            state.interpolationWorldTransform = body->getInterpolationWorldTransform();
+            state.linearVelocity = body->getLinearVelocity();
+            state.angularVelocity = body->getAngularVelocity();
+            state.interpolationLinearVelocity = body->getInterpolationLinearVelocity();
+            state.interpolationAngularVelocity = body->getInterpolationAngularVelocity();
+            state.activationState = body->getActivationState();
+            state.deactivationTime = body->getDeactivationTime();
+            bodies.push_back(state);
+        }
+        vehicle.SaveState(vehicleState);
+        if(props) props->SaveState(destructibleState);
+        if(opponents) opponents->SaveState(opponentsState);
+        if(lapTimer) lapTimer->SaveState(lapTimerState);
+        captured = true;
+
+        std::chrono::duration<float, std::micro> elapsed = std::chrono::high_resolution_clock::now() - start;
+        CaptureTime = elapsed.count();
+    }
+
+    // props, opponents and lap timer must be the same given to Capture
+    void Restore(Vehicle &vehicle, DestructibleProps *props = nullptr, AiOpponents *opponents = nullptr, LapTimer *lapTimer = nullptr) {
+        if(!captured) return;
+        auto start = std::chrono::high_resolution_clock::now();
+        auto world = simulation.dynamicsWorld;
+        // first the projectiles, the boxes and the debris, so the ones in the snapshot are again in the world
+        vehicle.RestoreState(vehicleState);
+        if(props) props->RestoreState(destructibleState);
+        if(opponents) opponents->RestoreState(opponentsState);
+        if(lapTimer) lapTimer->RestoreState(lapTimerState);
+        auto pairCache = world->getBroadphase()->getOverlappingPairCache();
+        for(int i = 0; i < bodies.size(); i++) {
+            auto &state = bodies[i];
+            btRigidBody *body = state.body;
+            body->setWorldTransform(state.worldTransform);
+            body->setInterpolationWorldTransform(state.interpolationWorldTransform);
+            body->setLinearVelocity(state.linearVelocity);
+            body->setAngularVelocity(state.angularVelocity);
+            body->setInterpolationLinearVelocity(state.interpolationLinearVelocity);
+            body->setInterpolationAngularVelocity(state.interpolationAngularVelocity);
+            body->clearForces();
+            body->forceActivationState(state.activationState);
+            body->setDeactivationTime(state.deactivationTime);
+            if(body->getMotionState()) {
+                body->getMotionState()->setWorldTransform(state.worldTransform);
+            }
+            // the contacts of the body refer to the old position
+            if(body->getBroadphaseHandle()) {
+                pairCache->cleanProxyFromPairs(body->getBroadphaseHandle(), world->getDispatcher());
+                world->updateSingleAabb(body);
+            }
+        }
+
+        std::chrono::duration<float, std::micro> elapsed = std::chrono::high_resolution_clock::now() - start;
+        RestoreTime = elapsed.count();
+    }
+
+    bool IsCaptured() {
+        return captured;
+    }
+
+    // forgets the captured state, e.g. before deleting bodies of the world
+    void Discard() {
+        bodies.clear();
+        captured = false;
+    }
+
+    int BodyCount() {
+        return bodies.size();
+    }
+
+    // time spent in the last capture and restore (microseconds)
+    float CaptureTime = 0.f;
+    float RestoreTime = 0.f;
+
+private:
+    Physics &simulation;
+    btAlignedObjectArray<RigidBodyState> bodies;
+    VehicleState vehicleState;
+    DestructibleState destructibleState;
+    AiOpponentsState opponentsState;
+    LapTimerState lapTimerState;
+    bool captured = false;
+};
+
+// Writes the whole world (shapes, bodies and constraints) in the binary .bullet format, the file
+// can be loaded with btBulletWorldImporter (Extras) to create the scene without building it,
+// or inspected with the Bullet tools
+bool serializeWorld(Physics &simulation, const char *path) {
+    auto world = simulation.dynamicsWorld;
+    btDefaultSerializer serializer;
+    world->serialize(&serializer);
+
+    FILE *file = fopen(path, "wb");
+    if(!file) {
+        printf("Unable to write the world to %s\n", path);
+        return false;
+    }
+    fwrite(serializer.getBufferPointer(), serializer.getCurrentBufferSize(), 1, file);
+    fclose(file);
+    return true;
+}
@@ -31,6 +31,10 @@ positive Z axis points "outside" the screen
 
 // Std. Includes
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
 
 // Loader estensioni OpenGL
 // http://glad.dav1d.de/
@@ -62,8 +66,20 @@ positive Z axis points "outside" the screen
 #include <utils/model.h>
 #include <utils/camera.h>
 #include <utils/physics.h>
+#include <utils/physics_profiler.h>
 #include <utils/vehicle.h>
 #include <utils/obstacle.h>
+#include <utils/scene.h>
+#include <utils/input_recorder.h>
+#include <utils/world_snapshot.h>
+#include <utils/contact_events.h>
+#include <utils/physics_lod.h>
+#include <utils/destructible.h>
+#include <utils/lap_timer.h>
+#include <utils/tyre_model.h>
+#include <utils/racing_line.h>
+#include <utils/ai_opponents.h>
+#include <utils/visibility.h>
 
 #include <utils/particle.h>
 
@@ -77,6 +93,9 @@ positive Z axis points "outside" the screen
 #include <utils/heightmap_renderer.h>
 #include <utils/heightmap_depth_renderer.h>
 #include <utils/shadow_renderer.h>
+#include <utils/debug_renderer.h>
+#include <utils/debris_renderer.h>
+#include <utils/snow_collider.h>
 
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw.h>
@@ -103,6 +122,10 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 // we initialize an array of booleans for each keyboard key
 bool keys[1024];
 
+// keys saved by the input recorder: the bit i of the recorded state is the key recordedKeys[i]
+const int recordedKeys[] = {GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_LEFT, GLFW_KEY_RIGHT, GLFW_KEY_SPACE, GLFW_KEY_R, GLFW_KEY_S, GLFW_KEY_F5, GLFW_KEY_F9};
+const int recordedKeysCount = sizeof(recordedKeys) / sizeof(recordedKeys[0]);
+
 // we need to store the previous mouse position to calculate the offset with the current frame
 GLfloat lastX, lastY;
 
@@ -118,6 +141,8 @@ GLfloat lastFrame = 0.0f;
 
 // boolean to activate/deactivate wireframe rendering
 GLboolean wireframe = GL_FALSE;
+// boolean to activate/deactivate the debug lines of the physics
+GLboolean physicsDebugDraw = GL_FALSE;
 
 // view and projection matrices (global because we need to use them in the keyboard callback)
 glm::mat4 view, projection;
@@ -131,6 +156,7 @@ glm::vec3 cameraOffset(0.f, 10.f, -25.f);
 // color of the falling objects
 glm::vec3 diffuseColor{1.0f,0.0f,0.0f};
 glm::vec3 carColor{.8f, .8f, .8f};
+glm::vec3 opponentColor{.8f, .2f, .1f};
 // color of the plane
 glm::vec3 planeMaterial1{.6f, .6f, .7f};
 glm::vec3 planeMaterial2{.3f, .3f, .3f};
@@ -173,9 +199,9 @@ void calculateShadowMapViewFrustum(glm::mat4 view, glm::mat4 projection, glm::ve
     *lightProjection = glm::ortho(-70.0f, 70.0f, -70.0f, 70.0f, near_plane, far_plane);
 }
 
-void updateCameraPosition(Vehicle vehicle, Camera &camera, const glm::vec3 offset, float deltaTime) {
+void updateCameraPosition(Vehicle &vehicle, Camera &camera, const glm::vec3 offset, float deltaTime) {
     // camera will always follow the car staying behind of it
-    auto bulletVehicle = vehicle.GetBulletVehicle();
+    auto &bulletVehicle = vehicle.GetBulletVehicle();
     btTransform chassisTransform = bulletVehicle.getChassisWorldTransform();
     btVector3 chassisPosition = chassisTransform * btVector3(0.f, 0.f, 0.f);
     btVector3 targetPosition = chassisTransform * btVector3(offset.x, offset.y, offset.z);
@@ -200,9 +226,9 @@ void updateCameraPosition(Vehicle vehicle, Camera &camera, const glm::vec3 offse
     camera.Position = newCameraPosition;
 }
 
-void updateEmitterPosition(Vehicle vehicle, ParticleEmitter *emitter, float deltaTime) {
+void updateEmitterPosition(Vehicle &vehicle, ParticleEmitter *emitter, float deltaTime) {
     // camera will always follow the car staying behind of it
-    auto bulletVehicle = vehicle.GetBulletVehicle();
+    auto &bulletVehicle = vehicle.GetBulletVehicle();
     btTransform chassisTransform = bulletVehicle.getChassisWorldTransform();
     auto chassisBox = vehicle.getChassisSize();
     btVector3 targetPosition = chassisTransform * btVector3(0, 0, -chassisBox.z);
@@ -210,25 +236,37 @@ void updateEmitterPosition(Vehicle vehicle, ParticleEmitter *emitter, float delt
     emitter->Position = toGLM(targetPosition);
 }
 
-void drawRigidBody(ObjectRenderer &renderer, btRigidBody *body) {
-    Model *objectModel;
+uint16_t recordedKeysState() {
+    uint16_t state = 0;
+    for(int i = 0; i < recordedKeysCount; i++) {
+        if(keys[recordedKeys[i]]) state |= 1 << i;
+    }
+    return state;
+}
 
-    // object transformation first getted as btTransform, then stored in "OpenGL"
-    // matrix and then converted to glm datatype
-    btTransform transform;
-    float matrix[16];
-    glm::mat4 modelMatrix = glm::mat4(1.0f);
-    glm::mat4 normalMatrix = glm::mat3(1.0f);
+void setRecordedKeys(uint16_t state) {
+    for(int i = 0; i < recordedKeysCount; i++) {
+        keys[recordedKeys[i]] = (state >> i) & 1;
+    }
+}
 
-    GLint program = 0;
-    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+void printFrameTimes(std::vector<float> &frameTimes) {
+    if(frameTimes.empty()) return;
+    std::sort(frameTimes.begin(), frameTimes.end());
+    double total = 0.0;
+    for(auto time: frameTimes) total += time;
+    auto percentile = [&](float p) { return frameTimes[(int) (p / 100.f * (frameTimes.size() - 1))]; };
+    printf("%d frames, ms/frame: mean %f, p50 %f, p90 %f, p99 %f, max %f\n", (int) frameTimes.size(),
+           total / frameTimes.size(), percentile(50.f), percentile(90.f), percentile(99.f), frameTimes.back());
+}
 
+void drawRigidBody(ObjectRenderer &renderer, btRigidBody *body) {
+    Model *objectModel;
     glm::vec3 obj_size;
 
-    if (body->getCollisionShape()->getShapeType() == BOX) {
+    if (body->getCollisionShape()->getShapeType() == BOX_SHAPE_PROXYTYPE) {
         // we point objectModel to the cube
         objectModel = cubeModel;
-        // TODO: retrive size of the cube
         auto box = (btBoxShape*) body->getCollisionShape();
         auto extends = box->getHalfExtentsWithMargin();
         obj_size = toGLM(extends);
@@ -245,22 +283,10 @@ void drawRigidBody(ObjectRenderer &renderer, btRigidBody *body) {
         renderer.SetColor(shootColor);
     }
 
-    // we take the transformation matrix of the rigid boby, as calculated by the physics engine
-    body->getMotionState()->getWorldTransform(transform);
-
-    // we convert the Bullet matrix (transform) to an array of floats
-    transform.getOpenGLMatrix(matrix);
-
-    // we reset to identity at each frame
-    modelMatrix = glm::mat4(1.0f);
-    normalMatrix = glm::mat3(1.0f);
-
-    // we create the GLM transformation matrix
-    // 1) we convert the array of floats to a GLM mat4 (using make_mat4 method)
-    // 2) Bullet matrix provides rotations and translations: it does not consider scale (usually the Collision Shape is generated using directly the scaled dimensions). If, like in our case, we have applied a scale to the original model, we need to multiply the scale to the rototranslation matrix created in 1). If we are working on an imported and not scaled model, we do not need to do this
-    modelMatrix = glm::make_mat4(matrix) * glm::scale(modelMatrix, obj_size);
-    // we create the normal matrix
-    renderer.SetModelTrasformation(modelMatrix);
+    // the motion state keeps the model and normal matrices of the body, rebuilt only when the body moved:
+    // Bullet provides rotations and translations, the scale of the model is applied to them (see RenderMotionState)
+    auto motionState = (RenderMotionState*) body->getMotionState();
+    renderer.SetModelTrasformation(motionState->ModelMatrix(obj_size), motionState->ModelNormalMatrix(obj_size));
 
     // we render the model
     // N.B.) if the number of models is relatively low, this approach (we render the same mesh several time from the same buffers) can work. If we must render hundreds or more of copies of the same mesh,
@@ -281,10 +307,10 @@ void drawPlane(ObjectRenderer &renderer, glm::vec3 planePos, glm::vec3 planeSize
     cubeModel->Draw();
 }
 
-void drawVehicle(ObjectRenderer &renderer, Vehicle &vehicle) {
-    auto bulletVehicle = vehicle.GetBulletVehicle();
+void drawVehicle(ObjectRenderer &renderer, Vehicle &vehicle, const glm::vec3 &color = carColor) {
+    auto &bulletVehicle = vehicle.GetBulletVehicle();
     // drawing the chassis
-    renderer.SetColor(carColor);
+    renderer.SetColor(color);
     // save a temp matrix for conversion from bullet to opengl
     float matrix[16];
 
@@ -335,8 +361,31 @@ void drawVehicle(ObjectRenderer &renderer, Vehicle &vehicle) {
 }
 
 ////////////////// MAIN function ///////////////////////
-int main()
+int main(int argc, char **argv)
 {
+    // car_race --record file: records the input of the run
+    // car_race --replay file: replays a recorded run and prints the frame times at the end
+    // in both cases the simulation is stepped with a fixed tick for each frame, so the run is deterministic
+    // car_race --opponents count: AI cars racing on the track
+    InputRecorder inputRecorder;
+    int opponentCount = 0;
+    for(int i = 1; i + 1 < argc; i++) {
+        if(strcmp(argv[i], "--record") == 0) {
+            inputRecorder.StartRecording(argv[i + 1], (uint32_t) time(NULL), 1.0f / 90.0f);
+        } else if(strcmp(argv[i], "--replay") == 0) {
+            if(!inputRecorder.LoadReplay(argv[i + 1])) return -1;
+        } else if(strcmp(argv[i], "--opponents") == 0) {
+            opponentCount = atoi(argv[i + 1]);
+        }
+    }
+    bool deterministic = inputRecorder.IsRecording() || inputRecorder.IsReplaying();
+    if(deterministic) {
+        // the random values of the particles depend only on the recorded seed
+        srand(inputRecorder.Seed);
+    }
+    // time of each frame during a replay (ms)
+    std::vector<float> frameTimes;
+
     // Initialization of OpenGL context using GLFW
     glfwInit();
     // We set OpenGL specifications required for this application
@@ -412,7 +461,10 @@ int main()
     glClearColor(0.26f, 0.46f, 0.98f, 1.0f);
 
     // instance of the physics class
-    Physics &bulletSimulation = Physics::GetInstance();
+    Physics bulletSimulation;
+    // times of the internal phases of Bullet, shown in the "Physics" window
+    PhysicsProfiler::Install();
+    bool tracePhysics = false;
 
     MeshRenderer renderer;
     renderer.lightDirection = glm::vec3(1.0f, 1.0f, 1.0f);
@@ -431,6 +483,9 @@ int main()
     // renderer for the heightmap depth buffer
     HeightmapDepthRenderer heightmapDepthRenderer;
 
+    // renderer for the debug lines of the physics
+    PhysicsDebugRenderer debugRenderer;
+
     // the Shader Program used on the framebuffer, for effect on the whole screen
     Shader postprocessing_shader = Shader("postprocessing.vert", "postprocessing.frag");
 
@@ -476,69 +531,15 @@ int main()
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 
-    // dimensions and position of the static plane
-    // we will use the cube mesh to simulate the plane, because we need some "height" in the mesh
-    // in order to make it work with the physics simulation
-    glm::vec3 plane_pos = glm::vec3(0.0f, -1.0f, 0.0f);
-    glm::vec3 plane_size = glm::vec3(400.0f, 0.1f, 400.0f);
-    glm::vec3 plane_rot = glm::vec3(0.0f, 0.0f, 0.0f);
-
-    // we create a rigid body for the plane. In this case, it is static, so we pass mass = 0;
-    // in this way, the plane will not fall following the gravity force.
-    btRigidBody *plane = bulletSimulation.createRigidBody(BOX, plane_pos, plane_size, plane_rot, 0.0f, 0.3f, 0.3f);
-    
-    glm::vec3 bridgePos(0.f, -1.f, 10.f);
-    Obstacle bridge(bridgeModel, bridgePos);
-
-    // glm::vec3 spPos(60.f, -1.8f, -70.f);
-    // Obstacle skatePark(skateParkModel, spPos);
-    
-    glm::vec3 trackPos(50.f, -2.3f, 20.f);
-    glm::vec3 trackDim(.7f, .7f, .7f);
-    Obstacle raceTrack(raceTrackModel, trackPos, trackDim);
-
-    glm::vec3 rampPos(60.f, -1.f, -50.f);
-    glm::vec3 rampDim(10.f, 10.f, 10.f);
-    Obstacle ramp(rampModel, rampPos, rampDim);
-    ramp.Illumination.Kd = 3.f;
-    ramp.Illumination.alpha = .3f;
-    ramp.Illumination.F0 = .9f;
-
-    /// creating objects for boowling scene
-    glm::vec3 trianglePinPosition(-50.f, 1.f, -50.f);
-    /// TODO: nice big ball
-    // auto ball = bulletSimulation.createRigidBody(SPHERE, glm::vec3(-100.f, 1.f, -70.f), glm::vec3(3.f, 3.f, 3.f), glm::vec3(0, 0, 0), 5.f, .3f, 2.f);
-    /// TODO: method DrawSphere
-    // create ball
-    auto ball = bulletSimulation.createRigidBody(SPHERE, glm::vec3(trianglePinPosition.x, 1.f, trianglePinPosition.z - 20.f), glm::vec3(3.f, 3.f, 3.f), glm::vec3(0, 0, 0), 15.f, .3f, 3.f);
-    // create pins
-    std::vector<btRigidBody*> pins;
-    glm::vec3 pinDim(10.f, 10.f, 10.f);
-    {
-        // create all pins
-        std::vector<glm::vec3> pinOffsets {
-            glm::vec3(0.f, 0.f, 0.f),
-            glm::vec3(-1.f, 0.f, 1.f),
-            glm::vec3(1.f, 0.f, 1.f),
-            glm::vec3(-2.f, 0.f, 2.f),
-            glm::vec3(0.f, 0.f, 2.f),
-            glm::vec3(2.f, 0.f, 2.f),
-            glm::vec3(-3.f, 0.f, 3.f),
-            glm::vec3(-1.f, 0.f, 3.f),
-            glm::vec3(1.f, 0.f, 3.f),
-            glm::vec3(3.f, 0.f, 3.f),
-        };
-
-        for(int i = 0; i < 0; i += 1) {
-            auto pinPos = trianglePinPosition + pinOffsets[i] * glm::vec3(1.5f, 1.f, 2.f);
-            glm::mat4 pinModelMatrix(1.0f);
-            pinModelMatrix = glm::translate(pinModelMatrix, pinPos);
-            pinModelMatrix = glm::scale(pinModelMatrix, pinDim);
-            // creating a rigid body for each mesh of the model
-            auto pin = bulletSimulation.createConvexDynamicRigidBodyFromModel(bowlingPinModel, pinPos, plane_rot, pinDim, .2f, .3f, .3f);
-            pins.push_back(pin);
-        }
-    }
+    // physical objects of the scene: plane, obstacles, bowling scene, vehicle and cubes
+    SceneModels sceneModels{bridgeModel, rampModel, raceTrackModel, bowlingPinModel};
+    RaceScene scene(bulletSimulation, sceneModels);
+    Vehicle &vehicle = scene.Car;
+    auto plane_pos = scene.PlanePosition;
+    auto plane_size = scene.PlaneSize;
+    scene.Ramp.Illumination.Kd = 3.f;
+    scene.Ramp.Illumination.alpha = .3f;
+    scene.Ramp.Illumination.F0 = .9f;
 
     /// create particles emitter for snow
     auto totalParticles = 1500;
@@ -600,52 +601,11 @@ int main()
     // set the type of the particle 
     particleRenderer.SetParticleShape(CIRCLE);
 
-    /// create vehicle
-    glm::vec3 chassisBox(1.f, .5f, 2.f);
-    // default wheel infos
-    WheelInfo wheelInfo;
-    Vehicle vehicle(chassisBox, wheelInfo);
     IlluminationModelParameters carIlluminationParameter;
     carIlluminationParameter.Kd = 4.2f;
     carIlluminationParameter.alpha = 0.2f;
     carIlluminationParameter.F0 = 0.9f;
 
-    // we create 25 rigid bodies for the cubes of the scene. In this case, we use BoxShape, with the same dimensions of the cubes, as collision shape of Bullet. For more complex cases, a Bounding Box of the model may have to be calculated, and its dimensions to be passed to the physics library
-    GLint num_side = 5;
-    // total number of the cubes
-    GLint total_cubes = num_side*num_side;
-    GLint i,j;
-    // position of the cube
-    glm::vec3 cube_pos;
-    // dimension of the cube
-    glm::vec3 cube_size = glm::vec3(.4f, 1.f, .4f);
-    // we set a small initial rotation for the cubes
-    glm::vec3 cube_rot = glm::vec3(0.1f, 0.0f, 0.1f);
-    // rigid body
-    btRigidBody *cube;
-
-    int cubes_start_i = bulletSimulation.dynamicsWorld->getCollisionObjectArray().size();
-    // we create a 5x5 grid of rigid bodies
-    for(i = 0; i < num_side; i++)
-    {
-        for(j = 0; j < num_side; j++)
-        {
-            // position of each cube in the grid (we add 3 to x to have a bigger displacement)
-            cube_pos = glm::vec3(3.0f + 5.f * i, 1.0f, j * 5.f);
-            // we create a rigid body (in this case, a dynamic body, with mass = 2)
-            cube = bulletSimulation.createRigidBody(BOX, cube_pos, cube_size, cube_rot, 2.0f, 0.3f, 0.3f);
-        }
-    }
-
-    // creating ramp
-    bulletSimulation.createRigidBody(BOX, glm::vec3(-50.f, -2.f, 0.f), glm::vec3(3.f), glm::vec3(0.f, 0.f, glm::radians(60.f)), 0, 0.3f, 0.3f);
-    // create some walls for bowling scene
-    /*
-    auto wall_size = glm::vec3(.5f, .7f, 10.f); 
-    bulletSimulation.createRigidBody(BOX, glm::vec3(trianglePinPosition.x - 8.f, plane_pos.y + wall_size.y, -50.f), wall_size, glm::vec3(0.f, 0.f, 0.f), 0, 0.3f, 0.3f);
-    bulletSimulation.createRigidBody(BOX, glm::vec3(trianglePinPosition.x + 8.f, plane_pos.y + wall_size.y, -50.f), wall_size, glm::vec3(0.f, 0.f, 0.f), 0, 0.3f, 0.3f);
-    */
-
     // Model and Normal transformation matrices for the objects in the scene: we set to identity
     glm::mat4 objModelMatrix = glm::mat4(1.0f);
     
@@ -671,6 +631,81 @@ int main()
     Heightmap heightmap(plane_pos.y, heightmap_width, heightmap_height, 1.f);
     // renderer for the heightmap
     HeightmapRenderer heightmapRenderer(heightmap);
+    // physical surface of the snow, updated from the heightmap depth buffer
+    SnowCollider snowCollider(bulletSimulation, heightmap, heightmapFBO, HEIGHTMAP_SIZE);
+    snowCollider.Deterministic = deterministic;
+
+    // state of the simulation saved with F5 and restored with F9
+    WorldSnapshot snapshot(bulletSimulation);
+    bool saveKeyPressed = false, restoreKeyPressed = false;
+
+    // contacts of the projectiles and of the props, read after each frame
+    ContactEventQueue contactEvents(bulletSimulation);
+    // the props far from the car are frozen, so the simulation cost depends on the neighbourhood of the car
+    PhysicsLod physicsLod(bulletSimulation);
+    // positions of the player and of the opponents, the centers of the LOD
+    btAlignedObjectArray<btVector3> lodCenters;
+    // bodies inside the frustum of the pass being drawn, the passes draw only them
+    VisibilityQuery visibility(bulletSimulation);
+    // visible bodies of the heightmap, shadow and main passes
+    int visibleHeightmap = 0, visibleShadow = 0, visibleMain = 0;
+    // the cubes break when hit hard by the car, the projectiles or other props: they share a fracture pattern
+    // baked here, and their fragments come from a pool of debris bodies
+    FracturedBox cubeFracture(bulletSimulation, scene.CubeSize);
+    DestructibleProps destructibleProps(bulletSimulation, cubeFracture);
+    for(int i = scene.CubesStart; i < bulletSimulation.dynamicsWorld->getNumCollisionObjects(); i++) {
+        btRigidBody *body = btRigidBody::upcast(bulletSimulation.dynamicsWorld->getCollisionObjectArray()[i]);
+        if(body && !body->isStaticObject() && body->getCollisionShape()->getShapeType() == BOX_SHAPE_PROXYTYPE)
+            destructibleProps.Add(body);
+    }
+    DebrisRenderer debrisRenderer(destructibleProps);
+
+    // the checkpoints of the lap, gates across the ellipse inscribed in the bounds of the race track
+    // the same ellipse, on the surface of the track, is the racing line of the AI opponents
+    LapTimer lapTimer(bulletSimulation, vehicle.Chassis);
+    std::vector<glm::vec3> racingLinePoints;
+    {
+        btVector3 trackMin, trackMax;
+        scene.RaceTrack.GetRigidBody()->getAabb(trackMin, trackMax);
+        btVector3 trackCenter = (trackMax + trackMin) * .5f, trackRadius = (trackMax - trackMin) * .5f * .8f;
+        const int numCheckpoints = 16;
+        for(int i = 0; i < numCheckpoints; i++) {
+            float angle = SIMD_2_PI * i / numCheckpoints;
+            btVector3 position(trackCenter.x() + trackRadius.x() * cos(angle), trackMin.y() + 3.f, trackCenter.z() + trackRadius.z() * sin(angle));
+            // the gate is across the direction of the ellipse, 4 sectors
+            float yaw = atan2(-trackRadius.x() * sin(angle), trackRadius.z() * cos(angle));
+            lapTimer.AddCheckpoint(position, btVector3(12.f, 4.f, 2.f), yaw, i % (numCheckpoints / 4) == 0);
+        }
+        const int numLinePoints = 64;
+        for(int i = 0; i < numLinePoints; i++) {
+            float angle = SIMD_2_PI * i / numLinePoints;
+            btVector3 from(trackCenter.x() + trackRadius.x() * cos(angle), trackMax.y() + 10.f, trackCenter.z() + trackRadius.z() * sin(angle));
+            btVector3 to(from.x(), trackMin.y() - 10.f, from.z());
+            // only the static objects, not the cubes or the gates
+            btCollisionWorld::ClosestRayResultCallback callback(from, to);
+            callback.m_collisionFilterGroup = COLLISION_RAY;
+            callback.m_collisionFilterMask = COLLISION_STATIC;
+            bulletSimulation.dynamicsWorld->rayTest(from, to, callback);
+            float height = callback.hasHit() ? callback.m_hitPointWorld.y() : trackMin.y();
+            racingLinePoints.push_back(glm::vec3(from.x(), height, from.z()));
+        }
+    }
+    RacingLine racingLine(racingLinePoints);
+    // the tyres of the car follow a magic formula evaluated by the tyre model, instead of the friction of Bullet
+    TyreModel tyreModel(bulletSimulation);
+    tyreModel.Add(vehicle);
+    bool useTyreModel = true;
+    // the opponents are added to the tyre model too, all the wheels are evaluated in one batch
+    AiOpponents opponents(bulletSimulation, racingLine, vehicle.getChassisSize(), WheelInfo(), &tyreModel);
+    opponents.SetCount(opponentCount);
+    contactEvents.Groups = COLLISION_PROJECTILE | COLLISION_PROP;
+    contactEvents.PersistEvents = false;
+    const int maxFrameEvents = 256;
+    ContactEvent frameEvents[maxFrameEvents];
+    int projectileHits = 0;
+    auto isProjectile = [](const btCollisionObject *object) {
+        return object->getBroadphaseHandle() && object->getBroadphaseHandle()->m_collisionFilterGroup == COLLISION_PROJECTILE;
+    };
 
     auto renderPlane = [&](ObjectRenderer &objectRenderer) {
         objectRenderer.UpdateIlluminationModel(illumination);
@@ -684,40 +719,55 @@ int main()
         drawPlane(objectRenderer, plane_pos, plane_size);
     };
 
-    auto renderObjects = [&](ObjectRenderer &objectRenderer) {
+    // draws the objects inside the frustum of the view-projection matrix, returns how many they are
+    auto renderObjects = [&](ObjectRenderer &objectRenderer, const glm::mat4 &viewProjection) {
+        auto &visible = visibility.Query(viewProjection);
+
         // car is supposed to be metal, so change the illumination model a bit
         objectRenderer.UpdateIlluminationModel(carIlluminationParameter);
         // do not use parallax map anymore but restore uv coordinate interpolation
         objectRenderer.SetTexCoordinateCalculation(UV);
         // reset normals calculation in vertex shader with normal matrix not anymore with normal map
         objectRenderer.SetNormalCalculation(FROM_MATRIX);
-        drawVehicle(objectRenderer, vehicle);
+        if(visibility.IsVisible(vehicle.Chassis))
+            drawVehicle(objectRenderer, vehicle);
+        for(int i = 0; i < opponents.Count(); i++) {
+            Vehicle &opponent = opponents.GetVehicle(i);
+            if(visibility.IsVisible(opponent.Chassis))
+                drawVehicle(objectRenderer, opponent, opponentColor);
+        }
 
         // illumination parameter for plastic objects
         objectRenderer.UpdateIlluminationModel(illumination);
-        // we need two variables to manage the rendering of both cubes and bullets
-        glm::vec3 obj_size;
-        // we ask Bullet to provide the total number of Rigid Bodies in the scene
-        int num_cobjs = bulletSimulation.dynamicsWorld->getNumCollisionObjects();
 
-        // we cycle among all the Rigid Bodies (starting from 1 to avoid the plane)
-        for (i=cubes_start_i; i< num_cobjs; i++)
+        // we cycle among the visible Rigid Bodies, the cubes and the bullets are the ones added after the scene
+        for (int i=0; i< visible.size(); i++)
         {
-            // we take the Collision Object from the list
-            btCollisionObject *obj = bulletSimulation.dynamicsWorld->getCollisionObjectArray()[i];
+            btCollisionObject *obj = visible[i];
+            if(obj->getWorldArrayIndex() < scene.CubesStart) continue;
+            // the debris is drawn with instancing by the debris renderer
+            if(obj->getBroadphaseHandle()->m_collisionFilterGroup == COLLISION_DEBRIS) continue;
+            // the chassis of the opponents are drawn with their wheels
+            if(obj->getBroadphaseHandle()->m_collisionFilterGroup == COLLISION_VEHICLE) continue;
             // we upcast it in order to use the methods of the main class RigidBody
             btRigidBody *body = btRigidBody::upcast(obj);
+            // the triggers (ghost objects) are not drawn
+            if(!body) continue;
+            // the snow heightfield is drawn by the heightmap renderer
+            if(body->getCollisionShape()->getShapeType() == TERRAIN_SHAPE_PROXYTYPE) continue;
 
             drawRigidBody(objectRenderer, body);
         }
 
         // draw the bridge
-        bridge.Draw(objectRenderer);
+        if(visibility.IsVisible(scene.Bridge.GetRigidBody()))
+            scene.Bridge.Draw(objectRenderer);
         
         // drawing the curved ramp
         objectRenderer.SetTexture(asphaltTexture, 2.f);
         objectRenderer.SetNormalMap(asphaltNormalMap);
-        ramp.Draw(objectRenderer);
+        if(visibility.IsVisible(scene.Ramp.GetRigidBody()))
+            scene.Ramp.Draw(objectRenderer);
 
         // reset colors for remaining obstacles
         objectRenderer.SetColor(glm::vec3(1.f, 0.f, 0.f));
@@ -725,38 +775,27 @@ int main()
         // skatePark.Draw(objectRenderer);
         
         // drawing the track
-        raceTrack.Draw(objectRenderer);
+        if(visibility.IsVisible(scene.RaceTrack.GetRigidBody()))
+            scene.RaceTrack.Draw(objectRenderer);
         
         // draw bowling ball
-        objectRenderer.SetColor(glm::vec3(0.f, 1.f, 1.f));
-        float matrix[16];
-        btTransform transform;
-        // we take the transformation matrix of the rigid boby, as calculated by the physics engine
-        ball->getMotionState()->getWorldTransform(transform);
-        // we convert the Bullet matrix (transform) to an array of floats
-        transform.getOpenGLMatrix(matrix);
-        // we reset to identity at each frame
-        auto modelMatrix = glm::mat4(1.0f);
-        auto normalMatrix = glm::mat3(1.0f);
-        // we create the GLM transformation matrix
-        // 1) we convert the array of floats to a GLM mat4 (using make_mat4 method)
-        // 2) Bullet matrix provides rotations and translations: it does not consider scale (usually the Collision Shape is generated using directly the scaled dimensions). If, like in our case, we have applied a scale to the original model, we need to multiply the scale to the rototranslation matrix created in 1). If we are working on an imported and not scaled model, we do not need to do this
-        modelMatrix = glm::make_mat4(matrix) * glm::scale(modelMatrix, glm::vec3(3.f, 3.f, 3.f));
-        // we create the normal matrix
-        objectRenderer.SetModelTrasformation(modelMatrix);
-        sphereModel->Draw();
+        if(visibility.IsVisible(scene.Ball)) {
+            objectRenderer.SetColor(glm::vec3(0.f, 1.f, 1.f));
+            auto ballMotionState = (RenderMotionState*) scene.Ball->getMotionState();
+            glm::vec3 ballSize(3.f, 3.f, 3.f);
+            objectRenderer.SetModelTrasformation(ballMotionState->ModelMatrix(ballSize), ballMotionState->ModelNormalMatrix(ballSize));
+            sphereModel->Draw();
+        }
         
         // drawing the bowling pins
         objectRenderer.SetColor(glm::vec3(1.f, 1.f, 1.f));
-        for(auto pin: pins) {
-            btTransform transform;
-            pin->getMotionState()->getWorldTransform(transform);
-            transform.getOpenGLMatrix(matrix);
-            auto pinModelMatrix = glm::make_mat4(matrix);
-            pinModelMatrix = glm::scale(pinModelMatrix, pinDim);
-            objectRenderer.SetModelTrasformation(pinModelMatrix);
+        for(auto pin: scene.Pins) {
+            if(!visibility.IsVisible(pin)) continue;
+            auto pinMotionState = (RenderMotionState*) pin->getMotionState();
+            objectRenderer.SetModelTrasformation(pinMotionState->ModelMatrix(scene.PinDimension), pinMotionState->ModelNormalMatrix(scene.PinDimension));
             bowlingPinModel->Draw();
         }
+        return visible.size();
     };
 
     auto renderHeightmap = [&](ObjectRenderer &objectRenderer) {
@@ -769,9 +808,9 @@ int main()
     };
 
     // function for drawing the entire scene, the passed renderer should be active
-    auto renderScene = [&](ObjectRenderer &objectRenderer) {
+    auto renderScene = [&](ObjectRenderer &objectRenderer, const glm::mat4 &viewProjection) {
         renderPlane(objectRenderer);
-        renderObjects(objectRenderer);
+        return renderObjects(objectRenderer, viewProjection);
     };
 
     /// Imgui setup
@@ -816,10 +855,24 @@ int main()
         }
         frameCount += 1;
         elapsedTimeFromLastProfilation += deltaTime;
+        PhysicsAllocator::UpdateRates(deltaTime);
 
         // Check is an I/O event is happening
         glfwPollEvents();
 
+        // the recorded input replaces the keyboard
+        if(inputRecorder.IsReplaying()) {
+            if(inputRecorder.Finished()) {
+                printFrameTimes(frameTimes);
+                break;
+            }
+            setRecordedKeys(inputRecorder.NextState());
+            frameTimes.push_back(deltaTime * 1000.f);
+        }
+        inputRecorder.Record(recordedKeysState());
+        // time used to update the simulation, fixed for the recorded runs
+        float simulationDeltaTime = deterministic ? inputRecorder.Tick : deltaTime;
+
         // if the is more fast then 100 km/h we activate the turbo using the particle system
         emitter->Active = vehicle.GetSpeed() > 100.f;
 
@@ -838,6 +891,16 @@ int main()
             previousFrameHeightmap.Clear();
         }
 
+        // snapshot of the simulation, only when the key is pressed (not while it's kept down)
+        if(keys[GLFW_KEY_F5] && !saveKeyPressed) {
+            snapshot.Capture(vehicle, &destructibleProps, &opponents, &lapTimer);
+        }
+        if(keys[GLFW_KEY_F9] && !restoreKeyPressed) {
+            snapshot.Restore(vehicle, &destructibleProps, &opponents, &lapTimer);
+        }
+        saveKeyPressed = keys[GLFW_KEY_F5];
+        restoreKeyPressed = keys[GLFW_KEY_F9];
+
         /// key handling
         // if space is pressed and we waited at least 'shootCooldown' since the last bullet
         if(keys[GLFW_KEY_SPACE]) {
@@ -864,14 +927,32 @@ int main()
     
         // steering
         if (keys[GLFW_KEY_RIGHT]) {
-            vehicle.SteerRight(deltaTime);
+            vehicle.SteerRight(simulationDeltaTime);
         } 
         if (keys[GLFW_KEY_LEFT]) {
-            vehicle.SteerLeft(deltaTime);
+            vehicle.SteerLeft(simulationDeltaTime);
+        }
+
+        {
+            // the vehicle update is profiled with the Bullet zones, so it is shown in the same tree
+            BT_PROFILE("Vehicle::Update");
+            vehicle.Update(simulationDeltaTime);
+        }
+        {
+            BT_PROFILE("AiOpponents::Update");
+            opponents.Update(simulationDeltaTime);
+        }
+        {
+            BT_PROFILE("PhysicsLod::Update");
+            // the props are simulated around the opponents too, they can hit them also far from the player
+            lodCenters.resize(0);
+            lodCenters.push_back(vehicle.Chassis->getWorldTransform().getOrigin());
+            for(int i = 0; i < opponents.Count(); i++) {
+                lodCenters.push_back(opponents.GetVehicle(i).Chassis->getWorldTransform().getOrigin());
+            }
+            physicsLod.Update(lodCenters);
         }
 
-        vehicle.Update(deltaTime);
-        
         // we update the physics simulation. We must pass the deltatime to be used for the update of the physical state of the scene.
         // Bullet works with a default timestep of 60 Hz (1/60 seconds). For smaller timesteps (i.e., if the current frame is computed faster than 1/60 seconds), Bullet applies interpolation rather than actual simulation.
         // In this example, we use deltatime from the last rendering: if it is < 1\60 sec, then we use it (thus "forcing" Bullet to apply simulation rather than interpolation), otherwise we use the default timestep (1/60 seconds) we have set above
@@ -879,7 +960,24 @@ int main()
         // The "correct" values to set up the timestep depends on the characteristics and complexity of the physical simulation, the amount of time spent for the other computations (e.g., complex shading), etc.
         // For example, this example, with limited lighting, simple materials, no texturing, works correctly even setting:
         // bulletSimulation.dynamicsWorld->stepSimulation(1.0/60.0,10);
-        bulletSimulation.dynamicsWorld->stepSimulation((deltaTime < maxSecPerFrame ? deltaTime : maxSecPerFrame), 10);
+        if(deterministic)
+            // exactly one step of the recorded tick for each frame
+            bulletSimulation.dynamicsWorld->stepSimulation(simulationDeltaTime, 1, simulationDeltaTime);
+        else
+            bulletSimulation.dynamicsWorld->stepSimulation((deltaTime < maxSecPerFrame ? deltaTime : maxSecPerFrame), 10);
+        PhysicsProfiler::EndStep();
+
+        // the contacts of the substeps of the frame, the objects of the begin events are still in the world
+        for(int count; (count = contactEvents.Read(frameEvents, maxFrameEvents)) > 0;) {
+            for(int i = 0; i < count; i++) {
+                auto &event = frameEvents[i];
+                if(event.Type == CONTACT_BEGIN && (isProjectile(event.ObjectA) || isProjectile(event.ObjectB)))
+                    projectileHits++;
+                destructibleProps.OnContact(event);
+            }
+        }
+        // the bodies are added and removed outside of the step
+        destructibleProps.Update(simulationDeltaTime);
 
         // reactivate depth test
         glEnable(GL_DEPTH_TEST);
@@ -907,8 +1005,10 @@ int main()
         heightmapDepthRenderer.SetModelTrasformation(quadTrasformation);
         drawQuad();
 
-        renderObjects(heightmapDepthRenderer);
+        visibleHeightmap = renderObjects(heightmapDepthRenderer, heightmapProjection * heightmapView);
         previousFrameHeightmap.CopyFromCurrentFrameBuffer();
+        // asynchronous readback of the snow for the physics simulation
+        snowCollider.Update();
 
         /// rendering the shadow map to the depth map framebuffer
         glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
@@ -919,7 +1019,7 @@ int main()
         calculateShadowMapViewFrustum(view, projection, renderer.lightDirection, &lightView, &lightProjection);
 
         shadowRenderer.Activate(lightView, lightProjection);
-        renderScene(shadowRenderer);
+        visibleShadow = renderScene(shadowRenderer, lightProjection * lightView);
 
         // render the standard scene
         // reset the framebuffer to main buffer application
@@ -942,7 +1042,13 @@ int main()
         // the renderer object can also render the object on a buffer (like shadow map)
         renderer.Activate(view, projection);
         renderer.SetShadowMap(shadowMap, lightView, lightProjection);
-        renderScene(renderer);
+        visibleMain = renderScene(renderer, projection * view);
+
+        // all the fragments of the broken cubes with a draw call for each fragment of the pattern
+        debrisRenderer.Activate(view, projection);
+        debrisRenderer.SetLightDirection(renderer.lightDirection);
+        debrisRenderer.SetColor(diffuseColor);
+        debrisRenderer.Draw();
 
         // activate the heightmap renderer with the view/projection transformations of the camera
         heightmapRenderer.Activate(view, projection);
@@ -953,6 +1059,12 @@ int main()
         heightmapRenderer.SetDepthTexture(heightmapTexture);
         renderHeightmap(heightmapRenderer);
 
+        // debug lines of the physics over the scene
+        if(physicsDebugDraw) {
+            debugRenderer.Activate(view, projection);
+            debugRenderer.Draw(bulletSimulation.dynamicsWorld);
+        }
+
         // update and always draw snow particles
         snowEmitter->Update(deltaTime);
         snowParticleRenderer.Activate(view, projection);
@@ -996,6 +1108,31 @@ int main()
             // Dialog for Vehicle configuration
             ImGui::Begin("Vehicle");
             ImGui::Text("Speed: %f Km/h", vehicle.GetSpeed());
+            ImGui::Text("Projectiles: %d / %d", vehicle.GetProjectiles().ActiveCount(), vehicle.GetProjectiles().Size());
+            ImGui::Text("Wheel ray candidates: %d (single rays %d)", vehicle.GetRaycaster().Candidates, vehicle.GetRaycaster().FallbackRays);
+            ImGui::Text("Projectile hits: %d (events dropped %d)", projectileHits, contactEvents.Dropped);
+            ImGui::Text("Broken cubes: %d, debris: %d / %d", destructibleProps.BrokenCount(), destructibleProps.ActiveCount(), destructibleProps.Size());
+            ImGui::SliderFloat("Break impulse", &destructibleProps.BreakImpulse, 1.f, 200.f);
+
+            ImGui::SeparatorText("Lap");
+            ImGui::Text("Lap %d: %.2f s, checkpoint %d / %d", lapTimer.Laps + 1, lapTimer.CurrentLapTime(), lapTimer.NextCheckpoint, lapTimer.CheckpointCount());
+            ImGui::Text("Last: %.2f s, best: %.2f s", lapTimer.LastLapTime, lapTimer.BestLapTime);
+            for(int i = 0; i < lapTimer.SectorTimes.size(); i++) {
+                ImGui::Text("Sector %d: %.2f s (best %.2f s)%s", i + 1, lapTimer.SectorTimes[i], lapTimer.BestSectorTimes[i], i == lapTimer.CurrentSector ? " <" : "");
+            }
+
+            ImGui::SeparatorText("Opponents");
+            ImGui::SliderInt("Count", &opponentCount, 0, 100);
+            ImGui::SameLine();
+            if(ImGui::Button("Spawn") && opponentCount != opponents.Count()) {
+                // the snapshot can't restore the chassis of the removed opponents, and it would leave
+                // the new ones where they are
+                snapshot.Discard();
+                opponents.SetCount(opponentCount);
+            }
+            ImGui::Text("Drivers: %.3f ms on %d threads", opponents.DriveTime, opponents.ThreadCount());
+            if(opponents.Count() > 0)
+                ImGui::Text("First opponent: lap %d, %.0f / %.0f m", opponents.GetDriver(0).Laps + 1, opponents.GetDriver(0).Progress, racingLine.Length());
 
             ImGui::SeparatorText("Wheel");
             ImGui::SliderFloat("Width", &vehicle.WheelInfo.width, .3f, .6f);
@@ -1006,6 +1143,17 @@ int main()
             ImGui::SliderFloat("Damping", &vehicle.WheelInfo.suspensionDamping, 1.f, 10.f);
             ImGui::SliderFloat("Compression", &vehicle.WheelInfo.suspensionCompression, 1.f, 10.f);
             ImGui::SliderFloat("Rest Length", &vehicle.WheelInfo.suspensionRestLength, 0.f, 2.f);
+            // the tyre model substeps its vehicles together
+            ImGui::SliderInt("Substeps", useTyreModel ? &tyreModel.Substeps : &vehicle.Substeps, 1, 8);
+            ImGui::SeparatorText("Tyres");
+            if(ImGui::Checkbox("Tyre model", &useTyreModel)) {
+                if(useTyreModel) tyreModel.Add(vehicle);
+                else tyreModel.Remove(vehicle);
+            }
+            ImGui::Text("Evaluate: %.3f ms (%d wheels)", tyreModel.EvaluateTime, tyreModel.Batch.Size());
+            ImGui::SliderFloat4("Longitudinal BCDE", &vehicle.WheelInfo.longitudinal.B, -2.f, 20.f);
+            ImGui::SliderFloat4("Lateral BCDE", &vehicle.WheelInfo.lateral.B, -2.f, 20.f);
+            ImGui::SliderFloat("Wheel mass", &tyreModel.WheelMass, 5.f, 50.f);
             ImGui::Separator();
             ImGui::SliderFloat("Engine Force", &vehicle.maxEngineForce, 500.0f, 3000.0f);
             ImGui::SliderFloat("Roll Influence", &vehicle.WheelInfo.rollInfluence, 0.0f, 2.0f);
@@ -1021,6 +1169,65 @@ int main()
             ImGui::End();
             */
 
+            /// Readback of the snow surface for the physics
+            ImGui::Begin("Snow");
+            ImGui::SliderInt("Readback Interval", &snowCollider.ReadbackInterval, 1, 60);
+            ImGui::Text("Update: %f ms", snowCollider.UpdateTime);
+            ImGui::Text("Latency: %d frames", snowCollider.LatencyFrames);
+            ImGui::Text("Readbacks: %d (skipped %d)", snowCollider.CompletedReadbacks, snowCollider.SkippedReadbacks);
+            ImGui::End();
+
+            /// Times of the phases of the last physics update and memory allocated by Bullet
+            ImGui::Begin("Physics");
+            ImGui::SeparatorText("Step");
+            for(auto &zone: PhysicsProfiler::Results()) {
+                ImGui::Text("%*s%s: %.3f ms (%d)", zone.Depth * 2, "", zone.Name, zone.Time, zone.Calls);
+            }
+            if(ImGui::Checkbox("Trace to physics_trace.csv", &tracePhysics)) {
+                if(tracePhysics)
+                    tracePhysics = PhysicsProfiler::OpenTrace("physics_trace.csv");
+                else
+                    PhysicsProfiler::CloseTrace();
+            }
+            // only the awake bodies are simulated and get their render matrices rebuilt
+            int dynamicBodies = 0, awakeBodies = 0, frozenBodies = 0;
+            auto &objects = bulletSimulation.dynamicsWorld->getCollisionObjectArray();
+            for(int i = 0; i < objects.size(); i++) {
+                if(objects[i]->isStaticOrKinematicObject()) continue;
+                dynamicBodies++;
+                if(objects[i]->isActive()) awakeBodies++;
+                if(objects[i]->getActivationState() == DISABLE_SIMULATION) frozenBodies++;
+            }
+            ImGui::Text("Awake bodies: %d / %d (frozen %d)", awakeBodies, dynamicBodies, frozenBodies);
+            ImGui::SliderFloat("Wake radius", &physicsLod.WakeRadius, 10.f, physicsLod.FreezeRadius);
+            ImGui::SliderFloat("Freeze radius", &physicsLod.FreezeRadius, physicsLod.WakeRadius, 500.f);
+            ImGui::Text("Visible: %d main, %d shadow, %d heightmap / %d", visibleMain, visibleShadow, visibleHeightmap, visibility.Total);
+            ImGui::Text("Pairs: %d, filter calls culled: %lld / %lld", bulletSimulation.dynamicsWorld->getPairCache()->getNumOverlappingPairs(),
+                        bulletSimulation.Pairs.CulledCalls, bulletSimulation.Pairs.FilterCalls);
+            ImGui::SeparatorText("Debug draw (9)");
+            ImGui::Text("Lines: %d static, %d dynamic", debugRenderer.StaticLines(), debugRenderer.DynamicLines());
+            int debugMode = debugRenderer.getDebugMode();
+            bool drawAabbs = debugMode & btIDebugDraw::DBG_DrawAabb, drawContacts = debugMode & btIDebugDraw::DBG_DrawContactPoints;
+            if(ImGui::Checkbox("AABBs", &drawAabbs) | ImGui::Checkbox("Contact points", &drawContacts)) {
+                debugMode = btIDebugDraw::DBG_DrawWireframe;
+                if(drawAabbs) debugMode |= btIDebugDraw::DBG_DrawAabb;
+                if(drawContacts) debugMode |= btIDebugDraw::DBG_DrawContactPoints;
+                debugRenderer.setDebugMode(debugMode);
+            }
+            ImGui::SeparatorText("Snapshot (F5 save, F9 restore)");
+            ImGui::Text("Bodies: %d", snapshot.BodyCount());
+            ImGui::Text("Capture: %.1f us, Restore: %.1f us", snapshot.CaptureTime, snapshot.RestoreTime);
+            if(ImGui::Button("Dump world to world.bullet")) {
+                serializeWorld(bulletSimulation, "world.bullet");
+            }
+            ImGui::SeparatorText("Memory");
+            for(int i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+                auto category = (PhysicsMemoryCategory) i;
+                auto &counters = PhysicsAllocator::Counters(category);
+                ImGui::Text("%s: %.1f KB, %.0f alloc/s", physicsMemoryCategoryNames[i], counters.LiveBytes / 1024.f, PhysicsAllocator::AllocationRate(category));
+            }
+            ImGui::End();
+
             /// Options for camera
             ImGui::Begin("Camera");
             ImGui::SliderFloat3("Offset", glm::value_ptr(cameraOffset), -40.f, 40.f);
@@ -1047,6 +1254,9 @@ int main()
         glfwSwapBuffers(window);
     }
 
+    PhysicsProfiler::CloseTrace();
+    inputRecorder.Stop();
+
     // ImGui Cleanup
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -1057,11 +1267,14 @@ int main()
     renderer.Delete();
     skyboxRenderer.Delete();
     shadowRenderer.Delete();
+    debugRenderer.Delete();
+    debrisRenderer.Delete();
     heightmapDepthRenderer.Delete();
     heightmapRenderer.Delete();
     snowParticleRenderer.Delete();
     particleRenderer.Delete();
     postprocessing_shader.Delete();
+    snowCollider.Delete();
     // we delete the data of the physical simulation
     bulletSimulation.Clear();
 
@@ -1093,6 +1306,10 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     // if 0 is pressed, we activate/deactivate wireframe rendering of models
     if(key == GLFW_KEY_0 && action == GLFW_PRESS)
         wireframe = !wireframe;
+
+    // if 9 is pressed, we activate/deactivate the debug lines of the physics
+    if(key == GLFW_KEY_9 && action == GLFW_PRESS)
+        physicsDebugDraw = !physicsDebugDraw;
     
     // we keep trace of the pressed keys
     // with this method, we can manage 2 keys pressed at the same time:
@@ -0,0 +1,15 @@
+#version 410 core
+
+in vec3 worldNormal;
+
+out vec4 colorFrag;
+
+uniform vec3 color;
+// direction towards the light, in world coordinates
+uniform vec3 lightVector;
+
+void main() {
+    // flat faces of the fragments, lambert with an ambient term
+    float diffuse = max(dot(normalize(worldNormal), normalize(lightVector)), 0.0);
+    colorFrag = vec4(color * (0.3 + 0.7 * diffuse), 1.0);
+}
@@ -0,0 +1,17 @@
+#version 410 core
+// vertex position and normal in the frame of the fragment
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+// model matrix of the instance (rigid transformation of the debris body)
+layout (location = 5) in mat4 modelMatrix;
+
+uniform mat4 projectionMatrix;
+uniform mat4 viewMatrix;
+
+// normal in world coordinates, the model matrix has no scale
+out vec3 worldNormal;
+
+void main() {
+    worldNormal = mat3(modelMatrix) * normal;
+    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(position, 1.0);
+}
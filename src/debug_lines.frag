@@ -0,0 +1,9 @@
+#version 410 core
+
+in vec3 lineColor;
+
+out vec4 colorFrag;
+
+void main() {
+    colorFrag = vec4(lineColor, 1.0);
+}
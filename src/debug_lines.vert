@@ -0,0 +1,14 @@
+#version 410 core
+// line vertex in world coordinates and its color
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 color;
+
+uniform mat4 projectionMatrix;
+uniform mat4 viewMatrix;
+
+out vec3 lineColor;
+
+void main() {
+    lineColor = color;
+    gl_Position = projectionMatrix * viewMatrix * vec4(position, 1.0);
+}
@@ -0,0 +1,170 @@
+/*
+Headless race: builds the same physical world of the game (plane, obstacles, bowling scene, vehicle and cubes)
+and steps it as fast as possible without a window or an OpenGL context, to load test the simulation
+also on machines without a GPU.
+
+The vehicle is driven by a scripted input (accelerate, steer left and right, brake and shoot), so
+each run simulates the same situation. At the end the time of the steps (mean and percentiles)
+and the number of overlapping pairs of the broadphase are printed.
+
+Usage: headless_race [seconds] [cubes] [worlds]
+    seconds: simulated time (default 60)
+    cubes: number of cubes in the grid, the game has 25 cubes (e.g. 10000 for a load test)
+    worlds: number of races simulated at the same time, each one in its own world and thread (default 1)
+*/
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <functional>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#ifdef _WIN32
+    #define APIENTRY __stdcall
+#endif
+
+// the meshes need the OpenGL types, but no OpenGL function is called without a context
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <utils/model.h>
+#include <utils/physics.h>
+#include <utils/scene.h>
+
+// fixed timestep of the simulation, the same maximum timestep used by the game
+const float timeStep = 1.0f / 90.0f;
+
+typedef std::chrono::high_resolution_clock headlessClock;
+
+// scripted input of the vehicle at a given time: a loop of 20 seconds where the car
+// accelerates, steers left and right, brakes and shoots
+void scriptedInput(Vehicle &vehicle, float time) {
+    float loopTime = fmod(time, 20.f);
+    if(loopTime < 14.f)
+        vehicle.Accelerate();
+    else if(loopTime < 17.f)
+        vehicle.Decelerate();
+
+    if(loopTime > 4.f && loopTime < 7.f)
+        vehicle.SteerLeft(timeStep);
+    else if(loopTime > 9.f && loopTime < 12.f)
+        vehicle.SteerRight(timeStep);
+
+    if(loopTime > 10.f)
+        vehicle.Shoot();
+
+    // the car can turn around hitting the cubes or the ramps
+    if(loopTime > 19.f)
+        vehicle.ResetRotation();
+}
+
+// value at the given percentile of the sorted samples
+double percentile(const std::vector<double> &sorted, float p) {
+    int index = (int) (p / 100.f * (sorted.size() - 1));
+    return sorted[index];
+}
+
+// results of the simulation of a world
+struct RaceResult {
+    double buildTime;
+    double totalTime;
+    int collisionObjects;
+    std::vector<double> stepTimes;
+    long long totalPairs = 0;
+    int maxPairs = 0;
+    // calls of the collision filter and the ones culled by the collision categories
+    long long filterCalls = 0;
+    long long culledCalls = 0;
+};
+
+// builds the world of the game and drives the car for the given number of steps
+// each race has its own Physics instance, so the races can run at the same time on different threads
+void runRace(const SceneModels &sceneModels, int cubes, int steps, RaceResult *result) {
+    Physics bulletSimulation;
+
+    auto buildStart = headlessClock::now();
+    RaceScene scene(bulletSimulation, sceneModels, cubes);
+    std::chrono::duration<double, std::milli> buildTime = headlessClock::now() - buildStart;
+    result->buildTime = buildTime.count();
+    result->collisionObjects = bulletSimulation.dynamicsWorld->getNumCollisionObjects();
+
+    result->stepTimes.reserve(steps);
+    auto pairCache = bulletSimulation.dynamicsWorld->getBroadphase()->getOverlappingPairCache();
+
+    auto start = headlessClock::now();
+    for(int i = 0; i < steps; i++) {
+        auto stepStart = headlessClock::now();
+        scriptedInput(scene.Car, i * timeStep);
+        scene.Car.Update(timeStep);
+        bulletSimulation.dynamicsWorld->stepSimulation(timeStep, 1, timeStep);
+        std::chrono::duration<double, std::milli> stepTime = headlessClock::now() - stepStart;
+        result->stepTimes.push_back(stepTime.count());
+
+        int pairs = pairCache->getNumOverlappingPairs();
+        result->totalPairs += pairs;
+        result->maxPairs = std::max(result->maxPairs, pairs);
+    }
+    std::chrono::duration<double, std::milli> total = headlessClock::now() - start;
+    result->totalTime = total.count();
+    result->filterCalls = bulletSimulation.Pairs.FilterCalls;
+    result->culledCalls = bulletSimulation.Pairs.CulledCalls;
+}
+
+////////////////// MAIN function ///////////////////////
+int main(int argc, char **argv)
+{
+    float seconds = 60.f;
+    int cubes = DEFAULT_SCENE_CUBES;
+    int worlds = 1;
+    if(argc > 1)
+        seconds = atof(argv[1]);
+    if(argc > 2)
+        cubes = atoi(argv[2]);
+    if(argc > 3)
+        worlds = atoi(argv[3]);
+    if(seconds < timeStep || cubes < 0 || worlds < 1) {
+        printf("Usage: headless_race [seconds] [cubes] [worlds]\n");
+        return -1;
+    }
+
+    // the same models of the game, loaded only on the CPU side
+    // they are only read by the worlds, so all the races share them
+    Model bridgeModel("../models/stone_bridge.obj", false);
+    Model rampModel("../models/ramp.obj", false);
+    Model raceTrackModel("../models/racetrack.obj", false);
+    Model bowlingPinModel("../models/bowling_pin.obj", false);
+    SceneModels sceneModels{&bridgeModel, &rampModel, &raceTrackModel, &bowlingPinModel};
+
+    int steps = (int) (seconds / timeStep);
+    std::vector<RaceResult> results(worlds);
+    std::vector<std::thread> threads;
+    auto start = headlessClock::now();
+    for(int i = 0; i < worlds; i++) {
+        threads.emplace_back(runRace, std::cref(sceneModels), cubes, steps, &results[i]);
+    }
+    for(auto &thread: threads) {
+        thread.join();
+    }
+    std::chrono::duration<double, std::milli> total = headlessClock::now() - start;
+
+    for(int i = 0; i < worlds; i++) {
+        auto &result = results[i];
+        std::sort(result.stepTimes.begin(), result.stepTimes.end());
+        printf("world %d: %d collision objects, built in %f ms\n", i, result.collisionObjects, result.buildTime);
+        printf("  %d steps (%f simulated seconds) in %f ms\n", steps, seconds, result.totalTime);
+        printf("  ms/step: mean %f, p50 %f, p90 %f, p99 %f, max %f\n", result.totalTime / steps,
+               percentile(result.stepTimes, 50.f), percentile(result.stepTimes, 90.f), percentile(result.stepTimes, 99.f), result.stepTimes.back());
+        printf("  broadphase pairs: mean %f, max %d\n", (double) result.totalPairs / steps, result.maxPairs);
+        printf("  collision filter calls: %lld, culled by the collision categories: %lld\n", result.filterCalls, result.culledCalls);
+    }
+    if(worlds > 1)
+        printf("%d worlds simulated in %f ms\n", worlds, total.count());
+    return 0;
+}
@@ -0,0 +1,300 @@
+/*
+Physics benchmark: runs some scenes of the game without rendering, to measure the cost of the physics simulation.
+
+- pins: a full rack of bowling pins hit by the ball, the narrowphase time is compared between
+        the convex hull with all the vertices of the model and the simplified one created by the Physics class
+- broadphase: the world of the game (with a given number of cubes) and the car accelerating, the broadphase
+              time (AABB update and pair search) and the overlapping pairs are compared between the
+              configurations of the broadphase
+- tyres: the tyre model of the vehicles evaluated for a given number of wheels with random slips, in a single
+         batch with the scalar and the SSE path and in batches of 4 wheels (one for each vehicle), the result is
+         in wheels evaluated per millisecond
+
+The application doesn't create an OpenGL context: models are loaded only on the CPU side.
+Usage: physics_benchmark [steps] [pins|broadphase|tyres|all] [cubes] [wheels]
+*/
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#ifdef _WIN32
+    #define APIENTRY __stdcall
+#endif
+
+// the meshes need the OpenGL types, but no OpenGL function is called without a context
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <utils/model.h>
+#include <utils/physics.h>
+#include <utils/physics_profiler.h>
+#include <utils/scene.h>
+#include <utils/tyre_model.h>
+#include <utils/random.h>
+
+// fixed timestep of the simulation, the same maximum timestep used by the game
+const float timeStep = 1.0f / 90.0f;
+
+typedef std::chrono::high_resolution_clock benchmarkClock;
+
+// the narrowphase zone of Bullet, its time is read from the PhysicsProfiler after each step
+const char *narrowphaseZone = "dispatchAllCollisionPairs";
+// the broadphase zones: update of the AABBs of the objects and search of the new pairs
+const char *updateAabbsZone = "updateAabbs";
+const char *pairsZone = "calculateOverlappingPairs";
+
+///////////////////  bowling pins benchmark ///////////////////////
+// the same bowling scene of the game
+glm::vec3 trianglePinPosition(-50.f, 1.f, -50.f);
+glm::vec3 pinDim(10.f, 10.f, 10.f);
+std::vector<glm::vec3> pinOffsets {
+    glm::vec3(0.f, 0.f, 0.f),
+    glm::vec3(-1.f, 0.f, 1.f),
+    glm::vec3(1.f, 0.f, 1.f),
+    glm::vec3(-2.f, 0.f, 2.f),
+    glm::vec3(0.f, 0.f, 2.f),
+    glm::vec3(2.f, 0.f, 2.f),
+    glm::vec3(-3.f, 0.f, 3.f),
+    glm::vec3(-1.f, 0.f, 3.f),
+    glm::vec3(1.f, 0.f, 3.f),
+    glm::vec3(3.f, 0.f, 3.f),
+};
+
+// creates a pin with a convex hull built from all the vertices of the model, as the Physics class did
+// before the simplification of the hulls
+btRigidBody *createFullHullPin(Physics &simulation, Model *model, glm::vec3 pos) {
+    auto hull = new btConvexHullShape();
+    for(auto &mesh: model->meshes) {
+        for(auto &vertex: mesh.vertices) {
+            auto vertexPos = vertex.Position;
+            hull->addPoint(btVector3(vertexPos.x, vertexPos.y, vertexPos.z), false);
+        }
+    }
+    hull->recalcLocalAabb();
+    hull->setLocalScaling(btVector3(pinDim.x, pinDim.y, pinDim.z));
+    simulation.collisionShapes.push_back(hull);
+
+    btTransform transform;
+    transform.setIdentity();
+    transform.setOrigin(btVector3(pos.x, pos.y, pos.z));
+    auto pin = simulation.localCreateRigidBody(.2f, transform, hull);
+    pin->setFriction(.3f);
+    pin->setRestitution(.3f);
+    return pin;
+}
+
+void removeBodies(Physics &simulation, std::vector<btRigidBody*> &bodies) {
+    for(auto body: bodies) {
+        simulation.dynamicsWorld->removeRigidBody(body);
+        delete body->getMotionState();
+        delete body;
+    }
+    bodies.clear();
+}
+
+// throws the ball on the pin rack and returns the narrowphase time in milliseconds
+double runPinRack(Physics &simulation, Model *pinModel, bool simplifiedHull, int steps, int *hullPoints) {
+    std::vector<btRigidBody*> bodies;
+    glm::vec3 rot(0.f, 0.f, 0.f);
+    for(auto &offset: pinOffsets) {
+        auto pinPos = trianglePinPosition + offset * glm::vec3(1.5f, 1.f, 2.f);
+        btRigidBody *pin;
+        if(simplifiedHull)
+            pin = simulation.createConvexDynamicRigidBodyFromModel(pinModel, pinPos, rot, pinDim, .2f, .3f, .3f);
+        else
+            pin = createFullHullPin(simulation, pinModel, pinPos);
+        bodies.push_back(pin);
+    }
+    *hullPoints = ((btConvexHullShape*) bodies[0]->getCollisionShape())->getNumPoints();
+
+    auto ball = simulation.createRigidBody(SPHERE, glm::vec3(trianglePinPosition.x, 1.f, trianglePinPosition.z - 20.f), glm::vec3(3.f, 3.f, 3.f), rot, 15.f, .3f, 3.f);
+    ball->setLinearVelocity(btVector3(0.f, 0.f, 15.f));
+    bodies.push_back(ball);
+
+    double narrowphaseTime = 0.0;
+    auto start = benchmarkClock::now();
+    for(int i = 0; i < steps; i++) {
+        simulation.dynamicsWorld->stepSimulation(timeStep, 1, timeStep);
+        PhysicsProfiler::EndStep();
+        narrowphaseTime += PhysicsProfiler::ZoneTime(narrowphaseZone);
+    }
+    std::chrono::duration<double, std::milli> total = benchmarkClock::now() - start;
+    printf("  total step time: %f ms (%f ms/step)\n", total.count(), total.count() / steps);
+
+    removeBodies(simulation, bodies);
+    return narrowphaseTime;
+}
+
+void benchmarkPins(int steps) {
+    Physics simulation;
+    Model pinModel("../models/bowling_pin.obj", false);
+
+    // the plane of the game
+    simulation.createRigidBody(BOX, glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(400.0f, 0.1f, 400.0f), glm::vec3(0.0f, 0.0f, 0.0f), 0.0f, 0.3f, 0.3f);
+
+    int hullPoints;
+    printf("pins: full convex hull\n");
+    double fullTime = runPinRack(simulation, &pinModel, false, steps, &hullPoints);
+    printf("  hull points: %d, narrowphase: %f ms (%f ms/step)\n", hullPoints, fullTime, fullTime / steps);
+
+    printf("pins: simplified cached convex hull\n");
+    double simplifiedTime = runPinRack(simulation, &pinModel, true, steps, &hullPoints);
+    printf("  hull points: %d, narrowphase: %f ms (%f ms/step)\n", hullPoints, simplifiedTime, simplifiedTime / steps);
+
+    simulation.Clear();
+}
+
+///////////////////  broadphase benchmark ///////////////////////
+struct BroadphaseOption {
+    const char *name;
+    PhysicsConfig config;
+};
+
+// runs the scene of the game with a broadphase configuration
+void runBroadphase(const BroadphaseOption &option, const SceneModels &sceneModels, int steps, int cubes) {
+    Physics simulation(option.config);
+    RaceScene scene(simulation, sceneModels, cubes);
+    auto pairCache = simulation.overlappingPairCache->getOverlappingPairCache();
+
+    double aabbTime = 0.0, pairsTime = 0.0;
+    long long pairs = 0;
+    int maxPairs = 0;
+    auto start = benchmarkClock::now();
+    for(int i = 0; i < steps; i++) {
+        // the car drives straight, so there is always something moving across the scene
+        scene.Car.Accelerate();
+        scene.Car.Update(timeStep);
+        simulation.dynamicsWorld->stepSimulation(timeStep, 1, timeStep);
+        PhysicsProfiler::EndStep();
+        aabbTime += PhysicsProfiler::ZoneTime(updateAabbsZone);
+        pairsTime += PhysicsProfiler::ZoneTime(pairsZone);
+        int stepPairs = pairCache->getNumOverlappingPairs();
+        pairs += stepPairs;
+        maxPairs = std::max(maxPairs, stepPairs);
+    }
+    std::chrono::duration<double, std::milli> total = benchmarkClock::now() - start;
+    printf("broadphase: %s\n", option.name);
+    printf("  total step time: %f ms (%f ms/step)\n", total.count(), total.count() / steps);
+    printf("  update AABBs: %f ms/step, pair search: %f ms/step\n", aabbTime / steps, pairsTime / steps);
+    printf("  pairs: %f mean, %d max\n", (double) pairs / steps, maxPairs);
+}
+
+void benchmarkBroadphase(int steps, int cubes) {
+    // the same models of the game, loaded only on the CPU side
+    Model bridgeModel("../models/stone_bridge.obj", false);
+    Model rampModel("../models/ramp.obj", false);
+    Model raceTrackModel("../models/racetrack.obj", false);
+    Model bowlingPinModel("../models/bowling_pin.obj", false);
+    SceneModels sceneModels{&bridgeModel, &rampModel, &raceTrackModel, &bowlingPinModel};
+
+    std::vector<BroadphaseOption> options;
+    options.push_back({"dbvt, all the AABBs updated (Bullet default)", raceSceneConfig(BROADPHASE_DBVT, cubes)});
+    options.back().config.UpdateOnlyActiveAabbs = false;
+    options.push_back({"dbvt, only active AABBs updated", raceSceneConfig(BROADPHASE_DBVT, cubes)});
+    options.push_back({"dbvt, deferred static pairs and dynamic tree optimization", raceSceneConfig(BROADPHASE_DBVT, cubes)});
+    options.back().config.DbvtDeferredCollide = true;
+    options.back().config.DbvtDynamicUpdates = 1;
+    options.push_back({"axis sweep, bounds of the plane", raceSceneConfig(BROADPHASE_AXIS_SWEEP, cubes)});
+
+    for(auto &option: options) {
+        runBroadphase(option, sceneModels, steps, cubes);
+    }
+}
+
+///////////////////  tyre model benchmark ///////////////////////
+// wheels with the default coefficients, random speeds and loads
+void fillTyres(TyreBatch &batch, int first, int wheels) {
+    WheelInfo wheelInfo;
+    for(int i = first; i < first + wheels; i++) {
+        batch.forwardSpeed[i] = uniform_between(-30.f, 30.f);
+        batch.lateralSpeed[i] = uniform_between(-5.f, 5.f);
+        batch.load[i] = uniform_between(1000.f, 3000.f);
+        batch.drive[i] = uniform_between(0.f, 2000.f);
+        batch.brake[i] = uniform_between(0.f, 100.f);
+        batch.radius[i] = wheelInfo.radius;
+        batch.inertia[i] = .5f * 20.f * wheelInfo.radius * wheelInfo.radius;
+        batch.longitudinalB[i] = wheelInfo.longitudinal.B;
+        batch.longitudinalC[i] = wheelInfo.longitudinal.C;
+        batch.longitudinalD[i] = wheelInfo.longitudinal.D;
+        batch.longitudinalE[i] = wheelInfo.longitudinal.E;
+        batch.lateralB[i] = wheelInfo.lateral.B;
+        batch.lateralC[i] = wheelInfo.lateral.C;
+        batch.lateralD[i] = wheelInfo.lateral.D;
+        batch.lateralE[i] = wheelInfo.lateral.E;
+        batch.spin[i] = batch.forwardSpeed[i] / wheelInfo.radius + uniform_between(-5.f, 5.f);
+    }
+}
+
+void benchmarkTyres(int steps, int wheels) {
+    // all the wheels in one batch, the same wheels for the two paths
+    TyreBatch batch;
+    batch.Resize(wheels);
+    fillTyres(batch, 0, wheels);
+    TyreBatch scalarBatch = batch;
+    auto start = benchmarkClock::now();
+    for(int i = 0; i < steps; i++) {
+        scalarBatch.EvaluateScalar(timeStep);
+    }
+    std::chrono::duration<double, std::milli> scalarTime = benchmarkClock::now() - start;
+
+    start = benchmarkClock::now();
+    for(int i = 0; i < steps; i++) {
+        batch.Evaluate(timeStep);
+    }
+    std::chrono::duration<double, std::milli> batchTime = benchmarkClock::now() - start;
+
+    // a batch for each vehicle
+    std::vector<TyreBatch> vehicles(wheels / 4);
+    for(auto &vehicle: vehicles) {
+        vehicle.Resize(4);
+        fillTyres(vehicle, 0, 4);
+    }
+    start = benchmarkClock::now();
+    for(int i = 0; i < steps; i++) {
+        for(auto &vehicle: vehicles) vehicle.Evaluate(timeStep);
+    }
+    std::chrono::duration<double, std::milli> vehiclesTime = benchmarkClock::now() - start;
+
+    // the forces are read, so the evaluation isn't removed by the optimizer
+    // and compared: the difference of the polynomial approximations, relative to the load
+    float checksum = 0.f, maxError = 0.f;
+    for(int i = 0; i < wheels; i++) {
+        checksum += batch.forwardForce[i] + batch.lateralForce[i];
+        float error = std::max(std::fabs(batch.forwardForce[i] - scalarBatch.forwardForce[i]), std::fabs(batch.lateralForce[i] - scalarBatch.lateralForce[i]));
+        maxError = std::max(maxError, error / batch.load[i]);
+    }
+    printf("tyres: %d wheels, %d steps (checksum %f)\n", wheels, steps, checksum);
+    printf("  single batch, scalar: %f ms/step, %f wheels/ms\n", scalarTime.count() / steps, (double) wheels * steps / scalarTime.count());
+    printf("  single batch, SSE: %f ms/step, %f wheels/ms (max force difference %f of the load)\n", batchTime.count() / steps, (double) wheels * steps / batchTime.count(), maxError);
+    printf("  batch of each vehicle: %f ms/step, %f wheels/ms\n", vehiclesTime.count() / steps, (double) vehicles.size() * 4 * steps / vehiclesTime.count());
+}
+
+////////////////// MAIN function ///////////////////////
+int main(int argc, char **argv)
+{
+    int steps = 600;
+    if(argc > 1)
+        steps = atoi(argv[1]);
+    const char *scene = argc > 2 ? argv[2] : "pins";
+    int cubes = argc > 3 ? atoi(argv[3]) : DEFAULT_SCENE_CUBES;
+    int wheels = argc > 4 ? atoi(argv[4]) : 4096;
+    bool all = strcmp(scene, "all") == 0;
+
+    PhysicsProfiler::Install();
+
+    if(all || strcmp(scene, "pins") == 0)
+        benchmarkPins(steps);
+    if(all || strcmp(scene, "broadphase") == 0)
+        benchmarkBroadphase(steps, cubes);
+    if(all || strcmp(scene, "tyres") == 0)
+        benchmarkTyres(steps, wheels);
+    return 0;
+}
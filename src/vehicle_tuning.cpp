@@ -0,0 +1,230 @@
+/*
+Vehicle tuning: simulates the same scripted lap for each combination of a grid of vehicle parameters
+(the ones tweaked with the ImGui sliders of the game) and writes the results in a csv file.
+
+Each combination is simulated in its own world, built as in the game, without rendering.
+The combinations are spread on all the cores of the machine, one world for each thread at the same time.
+
+The grid is a text file with a parameter for each line followed by the values to try, e.g.
+    stiffness 5 10 20
+    damping 2.3 4
+    engineForce 1000 2000 3000
+parameters: stiffness, damping, compression, friction, rollInfluence, restLength, engineForce
+the parameters not in the file keep the default value of the game.
+
+For each combination the csv contains: the parameters, the lap time (-1 if the lap was not completed
+before the timeout), the number of rollovers and the maximum speed.
+
+Usage: vehicle_tuning [grid file] [output csv] [timeout seconds]
+*/
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#ifdef _WIN32
+    #define APIENTRY __stdcall
+#endif
+
+// the meshes need the OpenGL types, but no OpenGL function is called without a context
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <utils/model.h>
+#include <utils/physics.h>
+#include <utils/scene.h>
+#include <utils/driver.h>
+
+// fixed timestep of the simulation, the same maximum timestep used by the game
+const float timeStep = 1.0f / 90.0f;
+
+// parameters of the vehicle that can be tuned, in the same order of the csv columns
+enum TuningParameter {
+    STIFFNESS,
+    DAMPING,
+    COMPRESSION,
+    FRICTION,
+    ROLL_INFLUENCE,
+    REST_LENGTH,
+    ENGINE_FORCE,
+    TUNING_PARAMETER_COUNT,
+};
+
+const char *tuningParameterNames[TUNING_PARAMETER_COUNT] = {
+    "stiffness", "damping", "compression", "friction", "rollInfluence", "restLength", "engineForce",
+};
+
+struct TuningResult {
+    float lapTime;
+    int rollovers;
+    float maxSpeed;
+};
+
+// values of a parameter in the game
+float defaultParameter(TuningParameter parameter) {
+    WheelInfo wheelInfo;
+    switch(parameter) {
+        case STIFFNESS: return wheelInfo.suspensionStiffness;
+        case DAMPING: return wheelInfo.suspensionDamping;
+        case COMPRESSION: return wheelInfo.suspensionCompression;
+        case FRICTION: return wheelInfo.friction;
+        case ROLL_INFLUENCE: return wheelInfo.rollInfluence;
+        case REST_LENGTH: return wheelInfo.suspensionRestLength;
+        case ENGINE_FORCE: return 2000.f;
+        default: return 0.f;
+    }
+}
+
+void applyParameters(Vehicle &vehicle, const float *parameters) {
+    vehicle.WheelInfo.suspensionStiffness = parameters[STIFFNESS];
+    vehicle.WheelInfo.suspensionDamping = parameters[DAMPING];
+    vehicle.WheelInfo.suspensionCompression = parameters[COMPRESSION];
+    vehicle.WheelInfo.friction = parameters[FRICTION];
+    vehicle.WheelInfo.rollInfluence = parameters[ROLL_INFLUENCE];
+    vehicle.WheelInfo.suspensionRestLength = parameters[REST_LENGTH];
+    vehicle.maxEngineForce = parameters[ENGINE_FORCE];
+}
+
+// reads the values of each parameter, returns false if the file is not valid
+bool readGrid(const char *path, std::vector<float> *grid) {
+    std::ifstream file(path);
+    if(!file.is_open()) {
+        printf("Unable to open the grid file %s\n", path);
+        return false;
+    }
+    std::string line;
+    while(std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string name;
+        if(!(stream >> name)) continue;
+        auto found = std::find_if(tuningParameterNames, tuningParameterNames + TUNING_PARAMETER_COUNT,
+                                  [&](const char *parameterName) { return name == parameterName; });
+        if(found == tuningParameterNames + TUNING_PARAMETER_COUNT) {
+            printf("Unknown parameter %s\n", name.c_str());
+            return false;
+        }
+        auto &values = grid[found - tuningParameterNames];
+        values.clear();
+        float value;
+        while(stream >> value) values.push_back(value);
+        if(values.empty()) {
+            printf("No values for the parameter %s\n", name.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+// drives the lap with a combination of parameters in a new world
+TuningResult simulateLap(const SceneModels &sceneModels, const float *parameters, float timeout) {
+    Physics bulletSimulation;
+    RaceScene scene(bulletSimulation, sceneModels);
+    Vehicle &vehicle = scene.Car;
+    applyParameters(vehicle, parameters);
+
+    WaypointDriver driver(circuitWaypoints(100.f, 12));
+    TuningResult result{-1.f, 0, 0.f};
+    int steps = (int) (timeout / timeStep);
+    for(int i = 0; i < steps; i++) {
+        if(driver.Drive(vehicle, timeStep)) {
+            result.lapTime = i * timeStep;
+            break;
+        }
+        vehicle.Update(timeStep);
+        bulletSimulation.dynamicsWorld->stepSimulation(timeStep, 1, timeStep);
+        result.maxSpeed = std::max(result.maxSpeed, vehicle.GetSpeed());
+    }
+    result.rollovers = driver.Rollovers;
+    return result;
+}
+
+////////////////// MAIN function ///////////////////////
+int main(int argc, char **argv)
+{
+    // by default only the suspension is tuned
+    std::vector<float> grid[TUNING_PARAMETER_COUNT];
+    for(int i = 0; i < TUNING_PARAMETER_COUNT; i++) {
+        grid[i].push_back(defaultParameter((TuningParameter) i));
+    }
+    grid[STIFFNESS] = {5.f, 10.f, 20.f};
+    grid[DAMPING] = {2.3f, 4.f, 6.f};
+    grid[COMPRESSION] = {2.f, 4.4f, 8.f};
+
+    if(argc > 1 && !readGrid(argv[1], grid))
+        return -1;
+    const char *outputPath = argc > 2 ? argv[2] : "tuning.csv";
+    float timeout = argc > 3 ? atof(argv[3]) : 120.f;
+
+    // all the combinations of the grid, the first parameter changes slower
+    int combinations = 1;
+    for(auto &values: grid) combinations *= values.size();
+    std::vector<float> parameters(combinations * TUNING_PARAMETER_COUNT);
+    for(int c = 0; c < combinations; c++) {
+        int index = c;
+        for(int p = TUNING_PARAMETER_COUNT - 1; p >= 0; p--) {
+            parameters[c * TUNING_PARAMETER_COUNT + p] = grid[p][index % grid[p].size()];
+            index /= grid[p].size();
+        }
+    }
+
+    // the same models of the game, loaded only on the CPU side and shared by all the worlds
+    Model bridgeModel("../models/stone_bridge.obj", false);
+    Model rampModel("../models/ramp.obj", false);
+    Model raceTrackModel("../models/racetrack.obj", false);
+    Model bowlingPinModel("../models/bowling_pin.obj", false);
+    SceneModels sceneModels{&bridgeModel, &rampModel, &raceTrackModel, &bowlingPinModel};
+
+    int threadCount = std::max(1u, std::thread::hardware_concurrency());
+    printf("simulating %d combinations on %d threads\n", combinations, threadCount);
+
+    // each thread takes the next combination not simulated yet
+    std::vector<TuningResult> results(combinations);
+    std::atomic<int> nextCombination(0);
+    std::atomic<int> completed(0);
+    auto worker = [&]() {
+        for(int c = nextCombination++; c < combinations; c = nextCombination++) {
+            results[c] = simulateLap(sceneModels, &parameters[c * TUNING_PARAMETER_COUNT], timeout);
+            printf("%d/%d\n", ++completed, combinations);
+        }
+    };
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> threads;
+    for(int i = 0; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    for(auto &thread: threads) {
+        thread.join();
+    }
+    std::chrono::duration<float> elapsed = std::chrono::high_resolution_clock::now() - start;
+    printf("sweep completed in %f s\n", elapsed.count());
+
+    FILE *output = fopen(outputPath, "w");
+    if(!output) {
+        printf("Unable to write the results to %s\n", outputPath);
+        return -1;
+    }
+    for(int p = 0; p < TUNING_PARAMETER_COUNT; p++) {
+        fprintf(output, "%s,", tuningParameterNames[p]);
+    }
+    fprintf(output, "lapTime,rollovers,maxSpeed\n");
+    for(int c = 0; c < combinations; c++) {
+        for(int p = 0; p < TUNING_PARAMETER_COUNT; p++) {
+            fprintf(output, "%f,", parameters[c * TUNING_PARAMETER_COUNT + p]);
+        }
+        fprintf(output, "%f,%d,%f\n", results[c].lapTime, results[c].rollovers, results[c].maxSpeed);
+    }
+    fclose(output);
+    printf("results written in %s\n", outputPath);
+    return 0;
+}